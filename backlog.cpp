@@ -0,0 +1,214 @@
+#include "backlog.h"
+#include "transcript.h" // transcript_name
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+backlog_ring::~backlog_ring() {
+  release();
+  if (head != nullptr)
+    munmap(head, bytes);
+}
+
+/**
+ * @brief map (creating if needed) the ring file
+ *
+ * A new file is all zeros, which is an empty ring.
+ *
+ * @param filename
+ * @return true
+ */
+bool backlog_ring::open(const std::string &filename) {
+  bytes = sizeof(header) + SLOTS * sizeof(slot);
+
+  int fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0664);
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+  fstat(fd, &st);
+  if ((size_t)st.st_size < bytes) {
+    if (ftruncate(fd, bytes) != 0) {
+      close(fd);
+      return false;
+    }
+  }
+
+  void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  head = (header *)map;
+  slots = (slot *)((char *)map + sizeof(header));
+
+  uint32_t magic = 0;
+  __atomic_compare_exchange_n(&head->magic, &magic, MAGIC, false,
+                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&head->magic, __ATOMIC_ACQUIRE) != MAGIC) {
+    // not ours (or an old format)
+    munmap(map, bytes);
+    head = nullptr;
+    slots = nullptr;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief are we the owner (or can we become the owner)?
+ *
+ * @return true we own it
+ */
+bool backlog_ring::claim(void) {
+  if (head == nullptr)
+    return false;
+
+  uint32_t me = (uint32_t)getpid();
+  uint32_t owner = __atomic_load_n(&head->owner_pid, __ATOMIC_ACQUIRE);
+  if (owner == me)
+    return true;
+
+  if (owner != 0) {
+    // still running?
+    if ((kill((pid_t)owner, 0) == 0) or (errno != ESRCH))
+      return false;
+  }
+
+  return __atomic_compare_exchange_n(&head->owner_pid, &owner, me, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+void backlog_ring::release(void) {
+  if (head == nullptr)
+    return;
+  uint32_t me = (uint32_t)getpid();
+  __atomic_compare_exchange_n(&head->owner_pid, &me, 0, false,
+                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+void backlog_ring::append(std::time_t stamp, int cmd, const std::string &nick,
+                          const std::string &text) {
+  if (head == nullptr)
+    return;
+
+  uint64_t seq = __atomic_fetch_add(&head->head, 1, __ATOMIC_ACQ_REL);
+  slot &s = slots[seq % SLOTS];
+
+  __atomic_store_n(&s.seq, 2 * seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  s.stamp = stamp;
+  s.cmd = (uint8_t)cmd;
+  s.nick_length = (uint8_t)std::min(nick.size(), sizeof(s.nick));
+  memcpy(s.nick, nick.data(), s.nick_length);
+  s.text_length = (uint16_t)std::min(text.size(), sizeof(s.text));
+  memcpy(s.text, text.data(), s.text_length);
+
+  __atomic_store_n(&s.seq, 2 * seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief the last count lines (oldest first)
+ *
+ * Slots being written (or overwritten) while we read are skipped.
+ *
+ * @param count
+ * @param oldest skip lines before this
+ * @return std::vector<backlog_line>
+ */
+std::vector<backlog_line> backlog_ring::recent(size_t count,
+                                               std::time_t oldest) const {
+  std::vector<backlog_line> lines;
+  if (head == nullptr)
+    return lines;
+
+  uint64_t end = __atomic_load_n(&head->head, __ATOMIC_ACQUIRE);
+  if (count > SLOTS)
+    count = SLOTS;
+  uint64_t start = (end > count) ? end - count : 0;
+
+  for (uint64_t seq = start; seq < end; ++seq) {
+    const slot &s = slots[seq % SLOTS];
+    uint64_t before = __atomic_load_n(&s.seq, __ATOMIC_ACQUIRE);
+    if (before != 2 * seq + 2)
+      continue;
+
+    backlog_line line;
+    line.stamp = s.stamp;
+    line.cmd = s.cmd;
+    line.nick.assign(s.nick, std::min<size_t>(s.nick_length, sizeof(s.nick)));
+    line.text.assign(s.text, std::min<size_t>(s.text_length, sizeof(s.text)));
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&s.seq, __ATOMIC_RELAXED) != before)
+      continue;
+    if (line.stamp < oldest)
+      continue;
+    lines.push_back(std::move(line));
+  }
+  return lines;
+}
+
+backlog_ring *channel_backlog::ring(const std::string &channel) {
+  std::string name = transcript_name(channel);
+  auto pos = rings.find(name);
+  if (pos != rings.end())
+    return pos->second.get();
+
+  std::unique_ptr<backlog_ring> r{new backlog_ring};
+  mkdir(directory.c_str(), 0775);
+  if (!r->open(directory + "/" + name + ".ring"))
+    return nullptr;
+  backlog_ring *result = r.get();
+  rings[name] = std::move(r);
+  return result;
+}
+
+/**
+ * @brief we joined channel
+ *
+ * @param channel
+ * @param count lines to replay
+ * @return std::vector<backlog_line> the last day's lines, up to count
+ */
+std::vector<backlog_line> channel_backlog::join(const std::string &channel,
+                                                size_t count) {
+  if (!enabled())
+    return {};
+  backlog_ring *r = ring(channel);
+  if (r == nullptr)
+    return {};
+
+  std::vector<backlog_line> lines = r->recent(count, time(nullptr) - 86400);
+  r->claim();
+  return lines;
+}
+
+/**
+ * @brief we left channel, let another node take over
+ */
+void channel_backlog::part(const std::string &channel) {
+  rings.erase(transcript_name(channel));
+}
+
+void channel_backlog::part_all(void) { rings.clear(); }
+
+/**
+ * @brief a line in channel, added if we're the owner
+ */
+void channel_backlog::append(const std::string &channel, std::time_t stamp,
+                             int cmd, const std::string &nick,
+                             const std::string &text) {
+  if (!enabled())
+    return;
+  backlog_ring *r = ring(channel);
+  if ((r != nullptr) and (r->claim()))
+    r->append(stamp, cmd, nick, text);
+}
@@ -0,0 +1,89 @@
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct backlog_line {
+  std::time_t stamp;
+  int cmd; // message_cmd
+  std::string nick;
+  std::string text;
+};
+
+/**
+ * @brief Recent lines of one channel, shared by the door nodes on this host.
+ *
+ * A memory mapped file (directory/channel.ring) holding a ring of SLOTS
+ * lines.  Writers claim a sequence number with an atomic add, and each slot
+ * is a seqlock (odd while it's being written), so readers never wait and
+ * never see a half written line.
+ *
+ * Only the owner node writes, so a line isn't added once per node.  The
+ * owner is a pid in the header:  a node claims the ring (compare and swap)
+ * when there's no owner, or the owner's process is gone, and releases it
+ * when it leaves the channel.
+ */
+class backlog_ring {
+public:
+  static const uint32_t MAGIC = 0x42524e47; // BRNG
+  static const uint64_t SLOTS = 256;
+
+  ~backlog_ring();
+
+  bool open(const std::string &filename);
+  bool claim(void);
+  void release(void);
+  void append(std::time_t stamp, int cmd, const std::string &nick,
+              const std::string &text);
+  std::vector<backlog_line> recent(size_t count, std::time_t oldest) const;
+
+private:
+  struct header {
+    uint32_t magic;
+    uint32_t owner_pid;
+    uint64_t head; // next sequence number
+    char pad[48];
+  };
+
+  struct slot {
+    uint64_t seq; // 2 * sequence + 2 when valid, odd while writing
+    int64_t stamp;
+    uint8_t cmd;
+    uint8_t nick_length;
+    uint16_t text_length;
+    char nick[32];
+    char text[460];
+  };
+
+  header *head = nullptr;
+  slot *slots = nullptr;
+  size_t bytes = 0;
+};
+
+/**
+ * @brief The rings for the channels we're in (io_context thread)
+ */
+class channel_backlog {
+public:
+  void begin(const std::string &directory) { this->directory = directory; }
+  bool enabled(void) const { return !directory.empty(); }
+
+  std::vector<backlog_line> join(const std::string &channel, size_t count);
+  void part(const std::string &channel);
+  void part_all(void);
+  void append(const std::string &channel, std::time_t stamp, int cmd,
+              const std::string &nick, const std::string &text);
+
+private:
+  backlog_ring *ring(const std::string &channel);
+
+  std::string directory;
+  std::map<std::string, std::unique_ptr<backlog_ring>> rings;
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "chanlist.h"
+#include "complete.h"
+#include "encoding.h"
+#include "input.h"
+
+#include <algorithm>
+#include <sstream>
+
+list_pager channel_pager;
+
+/**
+ * @brief parse the /list arguments
+ *
+ * @param args
+ * @param error set when returning false
+ * @return true
+ */
+bool list_filter::parse(const std::string &args, std::string &error) {
+  std::stringstream ss(args);
+  std::string arg;
+
+  while (ss >> arg) {
+    if ((arg[0] == '>') or (arg[0] == '<')) {
+      std::string number = arg.substr(1);
+      // more than 9 digits doesn't fit an int
+      if ((number.empty()) or (number.size() > 9) or
+          (number.find_first_not_of("0123456789") != std::string::npos)) {
+        error = "/list " + arg + " needs a number, like >10";
+        return false;
+      }
+      if (arg[0] == '>')
+        min_users = std::stoi(number);
+      else
+        max_users = std::stoi(number);
+    } else if (arg == "-name") {
+      by_name = true;
+    } else if (arg == "-users") {
+      by_name = false;
+    } else if (mask.empty()) {
+      mask = arg;
+    } else {
+      error = "/list [>users] [<users] [#mask] [-name]";
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief LIST arguments, for what the server can filter
+ *
+ * ELIST U handles >N / <N, ELIST M handles wildcard masks.  A mask without
+ * wildcards is a plain channel, which every server understands.
+ *
+ * @param elist ISUPPORT ELIST value
+ * @return std::string " args" or empty
+ */
+std::string list_filter::server_args(const std::string &elist) const {
+  std::string args;
+  bool users = (elist.find('U') != std::string::npos);
+
+  if (users and (min_users != -1))
+    args += ">" + std::to_string(min_users);
+  if (users and (max_users != -1)) {
+    if (!args.empty())
+      args += ",";
+    args += "<" + std::to_string(max_users);
+  }
+  if (!mask.empty()) {
+    bool wild = (mask.find_first_of("*?") != std::string::npos);
+    if ((!wild) or (elist.find('M') != std::string::npos)) {
+      if (!args.empty())
+        args += ",";
+      args += mask;
+    }
+  }
+
+  if (args.empty())
+    return args;
+  return " " + args;
+}
+
+void channel_list::begin(const list_filter &filter) {
+  this->filter = filter;
+  matcher = glob(irc_fold(filter.mask.empty() ? "*" : filter.mask));
+  listing = true;
+  total = 0;
+  matched = 0;
+  entries.clear();
+}
+
+/**
+ * @brief is a a better match than b?
+ */
+bool channel_list::better(const list_entry &a, const list_entry &b) const {
+  if ((!filter.by_name) and (a.users != b.users))
+    return a.users > b.users;
+  return irc_fold(a.channel) < irc_fold(b.channel);
+}
+
+/**
+ * @brief a 322 reply
+ *
+ * The server might not have filtered (no ELIST), so filter again here.
+ *
+ * @param channel
+ * @param users
+ * @param topic
+ */
+void channel_list::add(const std::string &channel, int users,
+                       const std::string &topic) {
+  ++total;
+  if ((filter.min_users != -1) and (users <= filter.min_users))
+    return;
+  if ((filter.max_users != -1) and (users >= filter.max_users))
+    return;
+  if ((!filter.mask.empty()) and (!matcher.match(irc_fold(channel))))
+    return;
+  ++matched;
+
+  auto worse = [this](const list_entry &a, const list_entry &b) -> bool {
+    return better(a, b);
+  };
+
+  list_entry entry{channel, users, topic};
+  if (entries.size() < MAX_ENTRIES) {
+    entries.push_back(std::move(entry));
+    std::push_heap(entries.begin(), entries.end(), worse);
+  } else if (better(entry, entries.front())) {
+    std::pop_heap(entries.begin(), entries.end(), worse);
+    entries.back() = std::move(entry);
+    std::push_heap(entries.begin(), entries.end(), worse);
+  }
+}
+
+/**
+ * @brief end of list (323)
+ *
+ * @return list_ptr sorted results
+ */
+list_ptr channel_list::finish(void) {
+  auto worse = [this](const list_entry &a, const list_entry &b) -> bool {
+    return better(a, b);
+  };
+  std::sort_heap(entries.begin(), entries.end(), worse);
+
+  auto result = std::make_shared<list_result>();
+  result->entries.swap(entries);
+  result->total = total;
+  result->matched = matched;
+  listing = false;
+  return result;
+}
+
+void list_pager::begin(list_ptr results) {
+  list = results;
+  pos = 0;
+}
+
+void list_pager::end(void) {
+  list.reset();
+  pos = 0;
+}
+
+/**
+ * @brief show the next page
+ *
+ * @param door
+ */
+void list_pager::page(door::Door &door) {
+  if (!list)
+    return;
+
+  door::ANSIColor info{door::COLOR::CYAN};
+  door::ANSIColor channel_color{door::COLOR::CYAN, door::ATTR::BOLD};
+  door::ANSIColor users_color{door::COLOR::YELLOW, door::ATTR::BOLD};
+  door::ANSIColor topic_color{door::COLOR::WHITE};
+
+  clear_input(door);
+
+  int lines = door.height - 2;
+  if (lines < 5)
+    lines = 5;
+
+  if (pos == 0) {
+    door << info << "* " << list->total << " channels, " << list->matched
+         << " matched";
+    if (list->matched > (int)list->entries.size())
+      door << ", showing the first " << list->entries.size();
+    door << door::reset << door::nl;
+    --lines;
+  }
+
+  for (; (lines > 0) and (pos < list->entries.size()); --lines, ++pos) {
+    const list_entry &entry = list->entries[pos];
+    std::string users = std::to_string(entry.users);
+    int left = door.width - 1 - (int)(entry.channel.size() + users.size() + 2);
+
+    door << channel_color << entry.channel << " " << users_color << users
+         << " " << topic_color;
+    if (left > 0)
+      door << to_terminal(entry.topic).substr(0, left);
+    door << door::reset << door::nl;
+  }
+
+  if (pos < list->entries.size()) {
+    door << info << "-- More (" << pos << "/" << list->entries.size()
+         << ") Space or Enter for more, Q to quit --" << door::reset
+         << door::nl;
+  } else {
+    door << info << "* End of list" << door::reset << door::nl;
+    end();
+  }
+
+  restore_input(door);
+}
+
+/**
+ * @brief a key, while the pager is active
+ *
+ * @param door
+ * @param c
+ * @return true the key was used
+ */
+bool list_pager::key(door::Door &door, int c) {
+  if ((c == ' ') or (c == 0x0d)) {
+    page(door);
+    return true;
+  }
+
+  if ((c == 'q') or (c == 'Q') or (c == 0x1b)) {
+    clear_input(door);
+    door::ANSIColor info{door::COLOR::CYAN};
+    door << info << "* End of list" << door::reset << door::nl;
+    restore_input(door);
+    end();
+    return true;
+  }
+
+  // anything else goes to the input line
+  end();
+  return false;
+}
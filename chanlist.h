@@ -0,0 +1,90 @@
+#ifndef CHANLIST_H
+#define CHANLIST_H
+
+#include "door.h"
+#include "ignore.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct list_entry {
+  std::string channel;
+  int users;
+  std::string topic;
+};
+
+/**
+ * @brief /list [>users] [<users] [#mask] [-name]
+ *
+ * Sorted by users (most first), or by channel name with -name.
+ */
+struct list_filter {
+  int min_users = -1; // more than this
+  int max_users = -1; // less than this
+  std::string mask;
+  bool by_name = false;
+
+  bool parse(const std::string &args, std::string &error);
+  std::string server_args(const std::string &elist) const;
+};
+
+/**
+ * @brief Finished /list results, published by the io_context thread.
+ */
+struct list_result {
+  std::vector<list_entry> entries;
+  int total = 0;
+  int matched = 0;
+};
+
+typedef std::shared_ptr<const list_result> list_ptr;
+
+/**
+ * @brief Collects the 322 replies (io_context thread)
+ *
+ * Only the best MAX_ENTRIES matches are kept (a heap with the worst entry on
+ * top), so a full network list costs a bounded amount of memory and never
+ * goes through the message queue.
+ */
+class channel_list {
+public:
+  static const size_t MAX_ENTRIES = 500;
+
+  channel_list() : matcher{"*"} {}
+
+  void begin(const list_filter &filter);
+  bool active(void) const { return listing; }
+  void add(const std::string &channel, int users, const std::string &topic);
+  list_ptr finish(void);
+
+private:
+  bool better(const list_entry &a, const list_entry &b) const;
+
+  bool listing = false;
+  list_filter filter;
+  glob matcher;
+  int total = 0;
+  int matched = 0;
+  std::vector<list_entry> entries;
+};
+
+/**
+ * @brief Shows list results a page at a time (render thread)
+ */
+class list_pager {
+public:
+  bool active(void) const { return list != nullptr; }
+  void begin(list_ptr results);
+  void page(door::Door &door);
+  bool key(door::Door &door, int c);
+
+private:
+  void end(void);
+  list_ptr list;
+  size_t pos = 0;
+};
+
+extern list_pager channel_pager;
+
+#endif
@@ -0,0 +1,63 @@
+#include "clock.h"
+
+std::atomic<bool> irc_clock::frozen{false};
+std::atomic<irc_clock::rep> irc_clock::ticks{0};
+std::time_t irc_clock::start = 0;
+
+irc_clock::time_point irc_clock::now(void) noexcept {
+  if (frozen)
+    return time_point(duration(ticks.load()));
+  return time_point(std::chrono::steady_clock::now().time_since_epoch());
+}
+
+/**
+ * @brief time(), for stamps
+ *
+ * @return std::time_t
+ */
+std::time_t irc_clock::wall(void) {
+  if (frozen)
+    return start + std::chrono::duration_cast<std::chrono::seconds>(
+                       duration(ticks.load()))
+                       .count();
+  return time(nullptr);
+}
+
+/**
+ * @brief freeze the clock (before anything uses it)
+ *
+ * @param when wall() starts here
+ */
+void irc_clock::simulate(std::time_t when) {
+  start = when;
+  ticks = 0;
+  frozen = true;
+}
+
+void irc_clock::advance(duration step) { ticks += step.count(); }
+
+/**
+ * @brief simulations:  move the clock ahead and run whatever came due
+ *
+ * The reactor only looks at the timers again when the earliest one
+ * changes, so a timer that's earlier than all of them nudges it.  Returns
+ * once everything due (and anything they posted) has run.
+ *
+ * @param io_context
+ * @param step
+ */
+void run_for(boost::asio::io_context &io_context, irc_clock::duration step) {
+  irc_clock::advance(step);
+
+  bool done = false;
+  irc_timer nudge(io_context);
+  nudge.expires_at(irc_clock::time_point::min());
+  nudge.async_wait(
+      [&done](const boost::system::error_code &) -> void { done = true; });
+
+  io_context.restart();
+  while ((!done) and (io_context.run_one()))
+    ;
+  io_context.restart();
+  io_context.poll();
+}
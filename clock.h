@@ -0,0 +1,44 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+
+/**
+ * @brief The clock the IRC protocol engine runs on
+ *
+ * Normally it's steady_clock (and time() for message stamps).  A simulation
+ * freezes it with simulate(), after that only advance() moves it:  the lag
+ * meter, sendq and CTCP timers, and message stamps all follow it, so hours
+ * of traffic can be run in seconds, the same way every time.
+ */
+class irc_clock {
+public:
+  typedef std::chrono::steady_clock::duration duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<irc_clock> time_point;
+  static constexpr bool is_steady = true;
+
+  static time_point now(void) noexcept;
+  static std::time_t wall(void);
+
+  // simulations only
+  static void simulate(std::time_t start);
+  static void advance(duration step);
+  static bool simulated(void) { return frozen; }
+
+private:
+  static std::atomic<bool> frozen;
+  static std::atomic<rep> ticks;
+  static std::time_t start;
+};
+
+typedef boost::asio::basic_waitable_timer<irc_clock> irc_timer;
+
+void run_for(boost::asio::io_context &io_context, irc_clock::duration step);
+
+#endif
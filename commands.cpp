@@ -0,0 +1,883 @@
+#include "commands.h"
+#include "config.h"
+#include "encoding.h"
+#include "focus.h"
+#include "networks.h"
+#include "render.h"
+#include "trace.h"
+#include "transcript.h"
+
+#include <cstdio>
+#include <cstring>
+
+uint32_t command_hash(const std::string &text)
+{
+  return command_hash(text.c_str());
+}
+
+static void cmd_help(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd);
+static void cmd_motd(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd);
+static void cmd_names(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd);
+static void cmd_quit(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd);
+static void cmd_talkto(door::Door &door, ircClient &irc,
+                       std::vector<std::string> &cmd);
+static void cmd_join(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd);
+static void cmd_focus(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd);
+static void cmd_part(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd);
+static void cmd_msg(door::Door &door, ircClient &irc,
+                    std::vector<std::string> &cmd);
+static void cmd_notice(door::Door &door, ircClient &irc,
+                       std::vector<std::string> &cmd);
+static void cmd_me(door::Door &door, ircClient &irc,
+                   std::vector<std::string> &cmd);
+static void cmd_nick(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd);
+static void cmd_topic(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd);
+static void cmd_whois(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd);
+static void cmd_list(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd);
+static void cmd_lag(door::Door &door, ircClient &irc,
+                    std::vector<std::string> &cmd);
+static void cmd_trace(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd);
+static void cmd_search(door::Door &door, ircClient &irc,
+                       std::vector<std::string> &cmd);
+static void cmd_history(door::Door &door, ircClient &irc,
+                        std::vector<std::string> &cmd);
+static void cmd_ignore(door::Door &door, ircClient &irc,
+                       std::vector<std::string> &cmd);
+static void cmd_unignore(door::Door &door, ircClient &irc,
+                         std::vector<std::string> &cmd);
+#ifdef DEVELOPER_CODE
+static void cmd_flood(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd);
+static void cmd_info(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd);
+#endif
+
+// can't do /motd it matches /me /msg
+// nick matches names.
+
+static constexpr irc_command commands[] = {
+    {"/help", "/?", 0, 0, permission::NONE, cmd_help, "/help", "/help"},
+    {"/join", nullptr, 1, 1, permission::JOIN, cmd_join, "/join #",
+     "/join [network/]#channel"},
+    {"/part", nullptr, 1, 1, permission::JOIN, cmd_part, "/part #",
+     "/part [network/]#channel"},
+    {"/talkto", "/talk", 1, 1, permission::NONE, cmd_talkto, "/talkto ",
+     "/talkto [network/]nick|#channel"},
+    {"/focus", nullptr, 0, 1, permission::NONE, cmd_focus, nullptr,
+     "/focus [on|off] (Ctrl-N goes to the next unread channel)"},
+    {"/msg", nullptr, 2, 2, permission::NONE, cmd_msg, nullptr,
+     "/msg [network/]nick|#channel message to send"},
+    {"/notice", nullptr, 2, 2, permission::NONE, cmd_notice, nullptr,
+     "/notice [network/]nick|#channel notice message to send"},
+    {"/me", nullptr, 1, 1, permission::NONE, cmd_me, nullptr,
+     "/me <action to perform>"},
+    {"/nick", nullptr, 1, 1, permission::NONE, cmd_nick, nullptr,
+     "/nick new_nick"},
+    {"/names", nullptr, 0, 1, permission::NONE, cmd_names, nullptr,
+     "/names [#channel]"},
+    {"/topic", nullptr, 0, 1, permission::NONE, cmd_topic, nullptr,
+     "/topic [#channel] [new topic]"},
+    {"/whois", nullptr, 1, 1, permission::NONE, cmd_whois, nullptr,
+     "/whois nick"},
+    {"/list", nullptr, 0, 1, permission::NONE, cmd_list, nullptr,
+     "/list [>users] [<users] [#mask] [-name]"},
+    {"/lag", nullptr, 0, 0, permission::NONE, cmd_lag, nullptr, "/lag"},
+    {"/trace", nullptr, 0, 0, permission::NONE, cmd_trace, nullptr,
+     "/trace (message latency, when trace_sample is set)"},
+    {"/search", nullptr, 1, 1, permission::NONE, cmd_search, nullptr,
+     "/search [[network/]#channel] words"},
+    {"/history", nullptr, 0, 1, permission::NONE, cmd_history, nullptr,
+     "/history [[network/]#channel] [since HH:MM]"},
+    {"/ignore", nullptr, 0, 1, permission::NONE, cmd_ignore, nullptr,
+     "/ignore [nick|mask [msg,notice,ctcp,action,joins|all] [#channel]]"},
+    {"/unignore", nullptr, 1, 1, permission::NONE, cmd_unignore, nullptr,
+     "/unignore nick|mask"},
+    {"/motd", nullptr, 0, 0, permission::NONE, cmd_motd, nullptr, "/motd"},
+    {"/quit", nullptr, 0, 1, permission::NONE, cmd_quit, "/quit ",
+     "/quit [message]"},
+#ifdef DEVELOPER_CODE
+    {"/flood", nullptr, 0, 0, permission::NONE, cmd_flood, nullptr, nullptr},
+    {"/info", nullptr, 0, 0, permission::NONE, cmd_info, nullptr, nullptr},
+#endif
+};
+
+static bool command_allowed(const irc_command &command)
+{
+  if (command.perm == permission::JOIN)
+    return current_config()->allow_join;
+  return true;
+}
+
+static const irc_command *hot_key_command(char c)
+{
+  for (auto const &command : commands)
+  {
+    if ((command.hot_key != nullptr) and (command.hot_key[1] == c) and
+        (command_allowed(command)))
+      return &command;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief find the command
+ *
+ * Exact name (or alias) by hash, then a hot key letter (/t = /talkto, even
+ * with /topic around), then a unique abbreviation (/wh = /whois).
+ *
+ * @param name
+ * @param error set when nothing is found
+ * @return const irc_command*
+ */
+static const irc_command *find_command(const std::string &name,
+                                       std::string &error)
+{
+  uint32_t hash = command_hash(name);
+
+  for (auto const &command : commands)
+  {
+    if ((command.hash == hash) and (name == command.name))
+      return &command;
+    if ((command.alias_hash == hash) and (command.alias != nullptr) and
+        (name == command.alias))
+      return &command;
+  }
+
+  if (name.size() == 2)
+  {
+    const irc_command *hot = hot_key_command(name[1]);
+    if (hot != nullptr)
+      return hot;
+  }
+
+  // abbreviation
+  const irc_command *found = nullptr;
+  std::string matches;
+
+  for (auto const &command : commands)
+  {
+    if (!command_allowed(command))
+      continue;
+    if (std::strncmp(command.name, name.c_str(), name.size()) == 0)
+    {
+      if (found == nullptr)
+        found = &command;
+      matches += " ";
+      matches += command.name;
+    }
+  }
+
+  if (found == nullptr)
+  {
+    error = "Unknown command " + name + ", try /help";
+    return nullptr;
+  }
+
+  if (matches.find(' ', 1) != std::string::npos)
+  {
+    error = name + " could be:" + matches;
+    return nullptr;
+  }
+  return found;
+}
+
+/**
+ * @brief Run a / command
+ *
+ * @param door
+ * @param irc
+ * @param input
+ */
+void run_command(door::Door &door, ircClient &irc, const std::string &input)
+{
+  std::string error;
+  std::string name = input.substr(0, input.find(' '));
+  const irc_command *command = find_command(name, error);
+
+  if (command == nullptr)
+  {
+    door << error << door::nl;
+    return;
+  }
+
+  if (!command_allowed(*command))
+  {
+    door << "SysOp has " << command->name + 1 << " disabled." << door::nl;
+    return;
+  }
+
+  std::string line = input;
+  std::vector<std::string> cmd = split_limit(line, command->max_args + 1);
+  cmd[0] = command->name;
+  // hot keys leave a trailing space
+  while ((cmd.size() > 1) and (cmd.back().empty()))
+    cmd.pop_back();
+
+  if ((int)cmd.size() - 1 < command->min_args)
+  {
+    if (command->usage != nullptr)
+      door << command->usage << door::nl;
+    return;
+  }
+
+  command->handler(door, irc, cmd);
+}
+
+/**
+ * @brief Commands this user can use
+ *
+ * For tab completion.
+ *
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> command_names(void)
+{
+  std::vector<std::string> names;
+  for (auto const &command : commands)
+  {
+    if (command_allowed(command))
+      names.push_back(command.name);
+  }
+  return names;
+}
+
+/**
+ * @brief Hot key expansion for "/c"
+ *
+ * Only when the hot key's command is the only one starting with "/c",
+ * otherwise the other commands couldn't be typed.
+ *
+ * @param c
+ * @return const char* expansion, or nullptr
+ */
+const char *hot_key_expand(char c)
+{
+  const irc_command *hot = hot_key_command(c);
+  if (hot == nullptr)
+    return nullptr;
+
+  for (auto const &command : commands)
+  {
+    if ((&command != hot) and (command_allowed(command)) and
+        (command.name[1] == c))
+      return nullptr;
+  }
+  return hot->hot_key;
+}
+
+/**
+ * @brief Is input an unmodified hot key expansion?
+ *
+ * @param input
+ * @return true
+ */
+bool is_hot_key(const std::string &input)
+{
+  if (input.size() < 2)
+    return false;
+  const char *hk = hot_key_expand(input[1]);
+  return (hk != nullptr) and (input == hk);
+}
+
+static void cmd_help(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd)
+{
+  door << "IRC Commands :" << door::nl;
+  for (auto const &command : commands)
+  {
+    if ((command.usage == nullptr) or (!command_allowed(command)))
+      continue;
+    door << command.usage;
+    if (command.alias != nullptr)
+      door << " (" << command.alias << ")";
+    door << door::nl;
+  }
+  door << "[TAB] completes nicks, #channels and /commands" << door::nl;
+  door << "[ESC] aborts input" << door::nl;
+}
+
+static void cmd_motd(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd)
+{
+  irc.write("MOTD");
+}
+
+static void cmd_names(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd)
+{
+  std::string talk = irc.talkto();
+  if (cmd.size() == 2)
+    talk = cmd[1];
+
+  if (talk[0] == '#')
+  {
+    // or we could pull this from /info & talk.
+    irc.write("NAMES " + talk);
+  }
+  else
+  {
+    door << "/names #channel" << door::nl;
+  }
+}
+
+static void cmd_quit(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd)
+{
+  // every network, we're leaving the door
+  if (cmd.size() == 2)
+    networks.write_all("QUIT :" + cmd[1]);
+  else
+    networks.write_all("QUIT");
+}
+
+static void cmd_talkto(door::Door &door, ircClient &irc,
+                       std::vector<std::string> &cmd)
+{
+  // network/#channel switches networks
+  std::string target = cmd[1];
+  ircClient &net = networks.select(target);
+  net.talkto(target);
+  door << "[talkto = " << net.display_name(target) << "]" << door::nl;
+}
+
+static void cmd_focus(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd)
+{
+  bool on = !focus.enabled();
+  if (cmd.size() == 2)
+  {
+    if ((cmd[1] != "on") and (cmd[1] != "off"))
+    {
+      door << "/focus [on|off]" << door::nl;
+      return;
+    }
+    on = (cmd[1] == "on");
+  }
+
+  focus.enable(door, on);
+  if (on)
+    door << "Focused:  only " << irc.display_name(irc.talkto())
+         << " and private messages are shown, the other channels wait."
+         << door::nl;
+  else
+    door << "Focus off, showing all channels." << door::nl;
+}
+
+static void cmd_join(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd)
+{
+  std::string target = cmd[1];
+  ircClient &net = networks.select(target);
+  std::string tmp = "JOIN " + target;
+  net.write(tmp);
+}
+
+static void cmd_part(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd)
+{
+  std::string target = cmd[1];
+  ircClient &net = networks.route(target);
+  std::string tmp = "PART " + target;
+  net.write(tmp);
+}
+
+// TODO: feed this and /me to render so DRY/one place to render
+static void cmd_msg(door::Door &door, ircClient &irc,
+                    std::vector<std::string> &cmd)
+{
+  std::string target = cmd[1];
+  ircClient &net = networks.route(target);
+  std::string tmp = "PRIVMSG " + target + " :" + cmd[2];
+  net.send_text("PRIVMSG", target, cmd[2]);
+  // build msg for render
+  tmp = ":" + net.nick + "!" + " " + tmp;
+  message_stamp msg;
+  msg.assign(irc_split(tmp));
+  render(msg, door, net);
+}
+
+static void cmd_notice(door::Door &door, ircClient &irc,
+                       std::vector<std::string> &cmd)
+{
+  std::string target = cmd[1];
+  ircClient &net = networks.route(target);
+  std::string tmp = "NOTICE " + target + " :" + cmd[2];
+  net.send_text("NOTICE", target, cmd[2]);
+  // build msg for render
+  tmp = ":" + net.nick + "!" + " " + tmp;
+  message_stamp msg;
+  msg.assign(irc_split(tmp));
+  render(msg, door, net);
+}
+
+static void cmd_me(door::Door &door, ircClient &irc,
+                   std::vector<std::string> &cmd)
+{
+  irc.send_text("ACTION", irc.talkto(), cmd[1]);
+  // build msg for render
+  std::string tmp =
+      ":" + irc.nick + "!" + " ACTION " + irc.talkto() + " :" + cmd[1];
+  message_stamp msg;
+  msg.assign(irc_split(tmp));
+  msg.target = irc.talkto_atom();
+  render(msg, door, irc);
+}
+
+static void cmd_nick(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd)
+{
+  std::string tmp = "NICK " + cmd[1];
+  irc.write(tmp);
+}
+
+static void cmd_topic(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd)
+{
+  std::string channel = irc.talkto();
+  std::string topic;
+
+  if (cmd.size() == 2)
+  {
+    if (cmd[1][0] == '#')
+    {
+      std::vector<std::string> args = split_limit(cmd[1], 2);
+      channel = args[0];
+      if (args.size() == 2)
+        topic = args[1];
+    }
+    else
+    {
+      topic = cmd[1];
+    }
+  }
+
+  if (channel[0] != '#')
+  {
+    door << "/topic #channel [new topic]" << door::nl;
+    return;
+  }
+
+  if (topic.empty())
+    irc.write("TOPIC " + channel);
+  else
+    irc.write("TOPIC " + channel + " :" + topic);
+}
+
+static void cmd_whois(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd)
+{
+  irc.write("WHOIS " + cmd[1]);
+}
+
+static void cmd_list(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd)
+{
+  list_filter filter;
+  std::string error;
+
+  if ((cmd.size() == 2) and (!filter.parse(cmd[1], error)))
+  {
+    door << error << door::nl;
+    return;
+  }
+
+  door << "Listing channels..." << door::nl;
+  irc.list(filter);
+}
+
+static void cmd_lag(door::Door &door, ircClient &irc,
+                    std::vector<std::string> &cmd)
+{
+  int lag = irc.lag_ms;
+  if (lag == 0)
+  {
+    door << "No lag measured yet." << door::nl;
+    return;
+  }
+
+  door << "Lag " << lag << " ms" << door::nl;
+  for (int x = 0; x < ircClient::LAG_BUCKETS; ++x)
+  {
+    unsigned count = irc.lag_histogram[x];
+    if (count == 0)
+      continue;
+    if (x == ircClient::LAG_BUCKETS - 1)
+      door << "  over " << ircClient::lag_buckets[x - 1];
+    else
+      door << "  under " << ircClient::lag_buckets[x];
+    door << " ms: " << count << door::nl;
+  }
+}
+
+/**
+ * @brief message latency by stage, and save the sampled trace
+ */
+static void cmd_trace(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd)
+{
+  if (!tracer.enabled())
+  {
+    door << "Tracing is off (trace_sample)." << door::nl;
+    return;
+  }
+
+  for (int stage = 0; stage < TRACE_STAGES; ++stage)
+  {
+    door << message_tracer::stage_name(stage) << ":";
+    for (int x = 0; x < message_tracer::BUCKETS; ++x)
+    {
+      unsigned count = tracer.histogram[stage][x];
+      if (count == 0)
+        continue;
+      if (x == message_tracer::BUCKETS - 1)
+        door << "  over " << message_tracer::buckets[x - 1];
+      else
+        door << "  under " << message_tracer::buckets[x];
+      door << " us " << count;
+    }
+    door << door::nl;
+  }
+
+  std::string error;
+  if (tracer.save(error))
+    door << "Saved " << tracer.filename() << door::nl;
+  else
+    door << error << door::nl;
+}
+
+/**
+ * @brief show transcript records, with the date when it changes
+ *
+ * @param door
+ * @param reader
+ * @param found record positions
+ */
+static void show_transcript(door::Door &door, transcript_reader &reader,
+                            const std::vector<size_t> &found)
+{
+  door::ANSIColor info{door::COLOR::CYAN};
+  door::ANSIColor nick_color{door::COLOR::CYAN, door::ATTR::BOLD};
+  door::ANSIColor text_color{door::COLOR::WHITE};
+  int last_day = -1;
+
+  for (size_t pos : found)
+  {
+    const transcript_record &record = reader[pos];
+    std::time_t when = record.stamp;
+    std::tm *tm = std::localtime(&when);
+
+    if (tm->tm_yday != last_day)
+    {
+      char date[40];
+      std::strftime(date, sizeof(date), "%a %b %d %Y", tm);
+      door << info << "--- " << date << " ---" << door::reset << door::nl;
+      last_day = tm->tm_yday;
+    }
+
+    stamp(when, door);
+    std::string nick(record.nick, record.nick_length);
+    if (record.cmd == CMD_ACTION)
+      door << nick_color << "* " << nick << " ";
+    else if (record.cmd == CMD_NOTICE)
+      door << nick_color << "-" << nick << "- ";
+    else
+      door << nick_color << "<" << nick << "> ";
+    door << text_color << to_terminal(reader.text(pos)) << door::reset
+         << door::nl;
+  }
+}
+
+/**
+ * @brief #channel, or network/#channel
+ *
+ * @param arg
+ * @return true
+ */
+static bool is_channel_arg(const std::string &arg)
+{
+  if (arg[0] == '#')
+    return true;
+  size_t slash = arg.find('/');
+  return (slash != std::string::npos) and (slash + 1 < arg.size()) and
+         (arg[slash + 1] == '#');
+}
+
+/**
+ * @brief open the transcript for the channel
+ *
+ * @return true, or false (and says why)
+ */
+static bool open_transcript(door::Door &door, transcript_reader &reader,
+                            const std::string &channel)
+{
+  if ((transcripts.path().empty()) or
+      (!reader.open(transcripts.path(), channel)))
+  {
+    door << "No transcript for " << channel << door::nl;
+    return false;
+  }
+  return true;
+}
+
+static void cmd_search(door::Door &door, ircClient &irc,
+                       std::vector<std::string> &cmd)
+{
+  ircClient *net = &irc;
+  std::string channel = irc.talkto();
+  std::string words = cmd[1];
+
+  if (is_channel_arg(words))
+  {
+    std::vector<std::string> args = split_limit(words, 2);
+    channel = args[0];
+    net = &networks.route(channel);
+    words = (args.size() == 2) ? args[1] : std::string();
+  }
+
+  if (words.empty())
+  {
+    door << "/search [[network/]#channel] words" << door::nl;
+    return;
+  }
+
+  transcript_reader reader;
+  if (!open_transcript(door, reader, net->display_name(channel)))
+    return;
+
+  std::vector<size_t> found = reader.search(words, 20);
+  if (found.empty())
+  {
+    door << "Nothing found in " << channel << door::nl;
+    return;
+  }
+  show_transcript(door, reader, found);
+}
+
+/**
+ * @brief HH:MM, the most recent time it was
+ *
+ * @param text
+ * @param since
+ * @return true
+ */
+static bool parse_since(const std::string &text, std::time_t &since)
+{
+  int hour, minute;
+  if ((std::sscanf(text.c_str(), "%d:%d", &hour, &minute) != 2) or
+      (hour < 0) or (hour > 23) or (minute < 0) or (minute > 59))
+    return false;
+
+  std::time_t now = std::time(nullptr);
+  std::tm tm = *std::localtime(&now);
+  tm.tm_hour = hour;
+  tm.tm_min = minute;
+  tm.tm_sec = 0;
+  since = std::mktime(&tm);
+  if (since > now)
+    since -= 24 * 60 * 60;
+  return true;
+}
+
+static void cmd_history(door::Door &door, ircClient &irc,
+                        std::vector<std::string> &cmd)
+{
+  const size_t max_lines = 50;
+  ircClient *net = &irc;
+  std::string channel = irc.talkto();
+  std::time_t since = 0;
+  bool have_since = false;
+
+  std::vector<std::string> args;
+  if (cmd.size() == 2)
+    args = split_limit(cmd[1]);
+
+  for (size_t x = 0; x < args.size(); ++x)
+  {
+    if (is_channel_arg(args[x]))
+    {
+      channel = args[x];
+      net = &networks.route(channel);
+    }
+    else if ((args[x] == "since") and (x + 1 < args.size()) and
+             (parse_since(args[x + 1], since)))
+    {
+      have_since = true;
+      ++x;
+    }
+    else
+    {
+      door << "/history [[network/]#channel] [since HH:MM]" << door::nl;
+      return;
+    }
+  }
+
+  transcript_reader reader;
+  if (!open_transcript(door, reader, net->display_name(channel)))
+    return;
+
+  std::vector<size_t> found;
+  size_t more = 0;
+
+  if (have_since)
+  {
+    for (size_t pos = reader.find_time(since); pos < reader.size(); ++pos)
+    {
+      if (reader[pos].flags & RECORD_CONTINUED)
+        continue;
+      if (found.size() < max_lines)
+        found.push_back(pos);
+      else
+        ++more;
+    }
+  }
+  else
+  {
+    // the last few
+    for (size_t pos = reader.size(); (pos > 0) and (found.size() < 20);)
+    {
+      --pos;
+      if (!(reader[pos].flags & RECORD_CONTINUED))
+        found.insert(found.begin(), pos);
+    }
+  }
+
+  if (found.empty())
+  {
+    door << "Nothing in " << channel << door::nl;
+    return;
+  }
+  show_transcript(door, reader, found);
+  if (more > 0)
+    door << "... and " << more << " more, try a later time." << door::nl;
+}
+
+/**
+ * @brief the ignore list is for every network
+ */
+static void ignore_everywhere(void)
+{
+  ignore_ptr matcher = user_ignores.compile();
+  for (auto &net : networks)
+    net->ignore(matcher);
+}
+
+static void cmd_ignore(door::Door &door, ircClient &irc,
+                       std::vector<std::string> &cmd)
+{
+  if (cmd.size() == 1)
+  {
+    // list them
+    if (user_ignores.rules().empty())
+      door << "You aren't ignoring anyone." << door::nl;
+    for (auto const &rule : user_ignores.rules())
+    {
+      door << "Ignoring " << rule.mask << " " << ignore_names(rule.types);
+      if (!rule.channel.empty())
+        door << " on " << rule.channel;
+      door << door::nl;
+    }
+    return;
+  }
+
+  std::vector<std::string> args = split_limit(cmd[1], 3);
+  unsigned types = IGNORE_ALL;
+  std::string channel;
+
+  if (args.size() > 1)
+  {
+    if (args[1][0] == '#')
+      channel = args[1];
+    else
+      types = ignore_types(args[1]);
+  }
+  if (args.size() > 2)
+    channel = args[2];
+
+  if (types == 0)
+  {
+    door << "/ignore nick|mask [msg,notice,ctcp,action,joins|all] [#channel]"
+         << door::nl;
+    return;
+  }
+
+  std::string mask = user_ignores.add(args[0], types, channel);
+  bool saved = user_ignores.save();
+  ignore_everywhere();
+  door << "Ignoring " << mask << " " << ignore_names(types);
+  if (!channel.empty())
+    door << " on " << channel;
+  door << door::nl;
+  if (!saved)
+    door << "(Unable to save your ignore list, this is only until you leave.)"
+         << door::nl;
+}
+
+static void cmd_unignore(door::Door &door, ircClient &irc,
+                         std::vector<std::string> &cmd)
+{
+  if (user_ignores.remove(cmd[1]))
+  {
+    bool saved = user_ignores.save();
+    ignore_everywhere();
+    door << "No longer ignoring " << normalize_mask(cmd[1]) << door::nl;
+    if (!saved)
+      door << "(Unable to save your ignore list, this is only until you "
+              "leave.)"
+           << door::nl;
+  }
+  else
+  {
+    door << "You aren't ignoring " << cmd[1] << door::nl;
+  }
+}
+
+#ifdef DEVELOPER_CODE
+
+static void cmd_flood(door::Door &door, ircClient &irc,
+                      std::vector<std::string> &cmd)
+{
+  std::string target = irc.talkto();
+  std::string bugz = "bugz";
+  for (int x = 0; x < 20; ++x)
+  {
+    std::string message = "PRIVMSG " + target +
+                          " : CHANNEL FLOOD TESTING THIS IS MESSAGE " +
+                          std::to_string(x + 1) + " TEST TEST TEST";
+    irc.write_queue(target, message);
+    message = "PRIVMSG " + bugz + " : USER FLOOD TESTING THIS IS MESSAGE " +
+              std::to_string(x + 1) + " TEST TEST TEST";
+    irc.write_queue(bugz, message);
+    message = "PRIVMSG apollo : USER FLOOD TESTING THIS IS MESSAGE " +
+              std::to_string(x + 1) + " TEST TEST TEST";
+    irc.write_queue("apollo", message);
+  }
+}
+
+static void cmd_info(door::Door &door, ircClient &irc,
+                     std::vector<std::string> &cmd)
+{
+  snapshot_ptr snapshot = irc.channels_snapshot();
+  door << "version " << snapshot->version << door::nl;
+  for (auto const &c : snapshot->channels)
+  {
+    door << "CH " << c.first << " ";
+    for (auto const &s : *c.second)
+    {
+      door << s << " ";
+    }
+    door << door::nl;
+  }
+}
+#endif
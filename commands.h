@@ -0,0 +1,77 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include "door.h"
+#include "irc.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief FNV-1a hash of a command name
+ *
+ * constexpr, so the registry's hashes are computed at compile time.
+ *
+ * @param text
+ * @param hash
+ * @return constexpr uint32_t
+ */
+constexpr uint32_t command_hash(const char *text, uint32_t hash = 2166136261u)
+{
+  return (*text == 0)
+             ? hash
+             : command_hash(text + 1, (hash ^ (uint8_t)*text) * 16777619u);
+}
+
+uint32_t command_hash(const std::string &text);
+
+enum class permission
+{
+  NONE,
+  JOIN, // sysop allow_join (covers /part too)
+};
+
+typedef void (*command_handler)(door::Door &door, ircClient &irc,
+                                std::vector<std::string> &cmd);
+
+/**
+ * @brief Command descriptor
+ *
+ * The input line is split into max_args arguments (the last one gets the
+ * rest of the line).  Fewer than min_args shows the usage.
+ *
+ * hot_key is what "/x" expands to as it is typed, where x is hot_key[1].
+ * That's only done when no other command starts with "/x" (so /topic can
+ * still be typed), otherwise "/x" is just short for the hot key's command.
+ */
+struct irc_command
+{
+  constexpr irc_command(const char *name, const char *alias, int min_args,
+                        int max_args, permission perm, command_handler handler,
+                        const char *hot_key, const char *usage)
+      : name{name}, alias{alias}, hash{command_hash(name)},
+        alias_hash{alias == nullptr ? 0 : command_hash(alias)},
+        min_args{min_args}, max_args{max_args}, perm{perm}, handler{handler},
+        hot_key{hot_key}, usage{usage}
+  {
+  }
+
+  const char *name;
+  const char *alias;
+  uint32_t hash;
+  uint32_t alias_hash;
+  int min_args;
+  int max_args;
+  permission perm;
+  command_handler handler;
+  const char *hot_key;
+  const char *usage;
+};
+
+void run_command(door::Door &door, ircClient &irc, const std::string &input);
+std::vector<std::string> command_names(void);
+const char *hot_key_expand(char c);
+bool is_hot_key(const std::string &input);
+
+#endif
@@ -0,0 +1,126 @@
+#include "complete.h"
+
+#include <algorithm>
+
+/**
+ * @brief Case fold using the rfc1459 casemapping
+ *
+ * A-Z and []\^ fold to a-z and {}|~.
+ *
+ * @param text
+ * @return std::string
+ */
+std::string irc_fold(const std::string &text) {
+  std::string folded = text;
+  for (auto &c : folded) {
+    if ((c >= 'A') and (c <= '^'))
+      c += 'a' - 'A';
+  }
+  return folded;
+}
+
+std::vector<prefix_index::entry>::iterator
+prefix_index::find(const std::string &folded) {
+  auto pos = std::lower_bound(
+      entries.begin(), entries.end(), folded,
+      [](const entry &e, const std::string &key) { return e.folded < key; });
+  if ((pos != entries.end()) and (pos->folded == folded))
+    return pos;
+  return entries.end();
+}
+
+void prefix_index::insert(const std::string &nick) {
+  entry e{irc_fold(nick), nick, 0};
+  auto pos = std::lower_bound(
+      entries.begin(), entries.end(), e.folded,
+      [](const entry &e, const std::string &key) { return e.folded < key; });
+  if ((pos != entries.end()) and (pos->folded == e.folded)) {
+    // already here, the case might have changed.
+    pos->nick = nick;
+    return;
+  }
+  entries.insert(pos, e);
+}
+
+void prefix_index::erase(const std::string &nick) {
+  auto pos = find(irc_fold(nick));
+  if (pos != entries.end())
+    entries.erase(pos);
+}
+
+/**
+ * @brief nick change, keeping the activity
+ *
+ * @param from
+ * @param to
+ * @return true from was in the index
+ */
+bool prefix_index::rename(const std::string &from, const std::string &to) {
+  auto pos = find(irc_fold(from));
+  if (pos == entries.end())
+    return false;
+  unsigned long active = pos->active;
+  entries.erase(pos);
+  insert(to);
+  touch(to, active);
+  return true;
+}
+
+void prefix_index::touch(const std::string &nick, unsigned long when) {
+  auto pos = find(irc_fold(nick));
+  if (pos != entries.end())
+    pos->active = when;
+}
+
+/**
+ * @brief nicks starting with prefix
+ *
+ * Most recently active first, then alphabetical.
+ *
+ * @param prefix
+ * @return std::vector<std::string>
+ */
+std::vector<std::string>
+prefix_index::complete(const std::string &prefix) const {
+  std::string folded = irc_fold(prefix);
+  auto pos = std::lower_bound(
+      entries.begin(), entries.end(), folded,
+      [](const entry &e, const std::string &key) { return e.folded < key; });
+
+  std::vector<const entry *> found;
+  while ((pos != entries.end()) and
+         (pos->folded.compare(0, folded.size(), folded) == 0)) {
+    found.push_back(&*pos);
+    ++pos;
+  }
+
+  std::stable_sort(found.begin(), found.end(),
+                   [](const entry *a, const entry *b) {
+                     return a->active > b->active;
+                   });
+
+  std::vector<std::string> results;
+  for (auto e : found)
+    results.push_back(e->nick);
+  return results;
+}
+
+/**
+ * @brief words (channels, commands) starting with prefix
+ *
+ * For the short lists, where an index isn't worth it.
+ *
+ * @param words
+ * @param prefix
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> complete_words(const std::vector<std::string> &words,
+                                        const std::string &prefix) {
+  std::string folded = irc_fold(prefix);
+  std::vector<std::string> results;
+  for (auto const &word : words) {
+    if (irc_fold(word).compare(0, folded.size(), folded) == 0)
+      results.push_back(word);
+  }
+  return results;
+}
@@ -0,0 +1,39 @@
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#include <string>
+#include <vector>
+
+std::string irc_fold(const std::string &text);
+
+/**
+ * @brief Prefix index of nicks for tab completion.
+ *
+ * Sorted by the case-folded nick, so a prefix is a binary search away.  Each
+ * nick keeps when it was last active, so completions can list the people
+ * talking first.
+ */
+class prefix_index {
+public:
+  void insert(const std::string &nick);
+  void erase(const std::string &nick);
+  bool rename(const std::string &from, const std::string &to);
+  void touch(const std::string &nick, unsigned long when);
+  bool empty(void) const { return entries.empty(); }
+
+  std::vector<std::string> complete(const std::string &prefix) const;
+
+private:
+  struct entry {
+    std::string folded;
+    std::string nick;
+    unsigned long active;
+  };
+  std::vector<entry>::iterator find(const std::string &folded);
+  std::vector<entry> entries;
+};
+
+std::vector<std::string> complete_words(const std::vector<std::string> &words,
+                                        const std::string &prefix);
+
+#endif
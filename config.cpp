@@ -0,0 +1,504 @@
+#include "config.h"
+#include "complete.h"  // irc_fold
+#include "transport.h" // valid_transport
+
+#include "yaml-cpp/yaml.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static config_ptr active_config = std::make_shared<const door_config>();
+
+config_ptr current_config(void) { return std::atomic_load(&active_config); }
+
+void publish_config(config_ptr cfg) { std::atomic_store(&active_config, cfg); }
+
+/**
+ * @brief Build a YAML node from the default configuration.
+ *
+ * These are the keys we add to the config file when they are missing.
+ *
+ * @return YAML::Node
+ */
+static YAML::Node default_node(void) {
+  door_config def;
+  YAML::Node node;
+  node["hostname"] = def.hostname;
+  node["port"] = def.port;
+  node["transport"] = def.transport;
+  node["allow_join"] = def.allow_join ? "1" : "0";
+  node["autojoin"] = def.autojoin;
+  node["realname"] = def.realname;
+  node["username"] = def.username;
+  node["input_delay"] = std::to_string(def.input_delay);
+  node["max_input"] = std::to_string(def.max_input);
+  node["timestamp_format"] = def.timestamp_format;
+  node["sendq_ms"] = std::to_string(def.sendq_ms);
+  node["paste_ms"] = std::to_string(def.paste_ms);
+  node["paste_confirm"] = std::to_string(def.paste_confirm);
+  node["max_queue"] = std::to_string(def.max_queue);
+  node["log_level"] = std::to_string(def.log_level);
+  node["ping_interval"] = std::to_string(def.ping_interval);
+  node["ping_missed"] = std::to_string(def.ping_missed);
+  node["single_reactor"] = def.single_reactor ? "1" : "0";
+  node["ignore_dir"] = def.ignore_dir;
+  node["transcript_dir"] = def.transcript_dir;
+  node["backlog_dir"] = def.backlog_dir;
+  node["backlog_lines"] = std::to_string(def.backlog_lines);
+  node["history_lines"] = std::to_string(def.history_lines);
+  node["encoding"] = def.encoding;
+  node["focus"] = def.focus ? "1" : "0";
+  node["input_layout"] = def.input_layout;
+  node["theme"] = def.theme;
+  node["trace_sample"] = std::to_string(def.trace_sample);
+  node["trace_dir"] = def.trace_dir;
+  node["highlight"] = def.highlight;
+  node["numeric_level"] = std::to_string(def.numeric_level);
+  return node;
+}
+
+/**
+ * @brief Add any missing default keys to the config file.
+ *
+ * Several door nodes can start at the same time, so this takes an exclusive
+ * lock on filename.lock, re-reads the file under the lock, and replaces it
+ * with rename() so no one ever sees a half written file.
+ *
+ * If the existing file doesn't parse, we leave it alone.
+ *
+ * @param filename
+ * @return true file is ok
+ * @return false unable to read/update the file
+ */
+bool ensure_config_defaults(const std::string &filename) {
+  std::string lockname = filename + ".lock";
+  int fd = open(lockname.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1)
+    return false;
+
+  if (flock(fd, LOCK_EX) == -1) {
+    close(fd);
+    return false;
+  }
+
+  bool ok = true;
+  YAML::Node config;
+  {
+    std::ifstream f(filename.c_str());
+    if (f.good()) {
+      try {
+        config = YAML::Load(f);
+      } catch (YAML::Exception &e) {
+        ok = false;
+      }
+    }
+  }
+
+  if (ok) {
+    bool update_config = false;
+
+    for (auto const &kv : default_node()) {
+      std::string key = kv.first.as<std::string>();
+      if (!config[key]) {
+        config[key] = kv.second;
+        update_config = true;
+      }
+    }
+
+    if (update_config) {
+      std::string tempname =
+          filename + "." + std::to_string(getpid()) + ".tmp";
+      {
+        std::ofstream fout(tempname.c_str());
+        fout << "# IRC Chat Door configuration" << std::endl;
+        fout << "# to add comments (that don't get destroyed)" << std::endl;
+        fout << "# Add comments as key: values, like:" << std::endl;
+        fout << "# _comment: This will survive the test of time." << std::endl;
+        fout << "# %r AM/PM, %T 24 hour time" << std::endl;
+        fout << "# log_level 0 none, 1 traffic, 2 parser details" << std::endl;
+        fout << "# single_reactor 1 runs input and irc on one thread"
+             << std::endl;
+        fout << std::endl;
+        fout << config << std::endl;
+        fout << "# end yaml config" << std::endl;
+        ok = fout.good();
+      }
+
+      if (ok)
+        ok = (std::rename(tempname.c_str(), filename.c_str()) == 0);
+      if (!ok)
+        std::remove(tempname.c_str());
+    }
+  }
+
+  flock(fd, LOCK_UN);
+  close(fd);
+  return ok;
+}
+
+/**
+ * @brief Read an integer setting, clamped to [low, high].
+ *
+ * @param config
+ * @param key
+ * @param value in: default, out: value
+ * @param low
+ * @param high
+ * @param problems
+ */
+static void read_int(YAML::Node &config, const char *key, int &value, int low,
+                     int high, std::vector<std::string> &problems) {
+  if (!config[key])
+    return;
+
+  int v;
+  try {
+    v = config[key].as<int>();
+  } catch (YAML::Exception &e) {
+    problems.push_back(std::string(key) + " is not a number, using " +
+                       std::to_string(value));
+    return;
+  }
+
+  if ((v < low) or (v > high)) {
+    problems.push_back(std::string(key) + " must be " + std::to_string(low) +
+                       " to " + std::to_string(high) + ", using " +
+                       std::to_string(value));
+    return;
+  }
+  value = v;
+}
+
+static void read_string(YAML::Node &config, const char *key,
+                        std::string &value) {
+  if (config[key])
+    value = config[key].as<std::string>();
+}
+
+/**
+ * @brief the networks list
+ *
+ * networks:
+ *   - { name: local, hostname: 127.0.0.1, autojoin: "#bugz" }
+ *   - { name: libera, hostname: irc.libera.chat, port: 6697 }
+ *
+ * Without it, there's one network from the top level keys.
+ */
+static void read_networks(YAML::Node &config, door_config &cfg,
+                          std::vector<std::string> &problems) {
+  YAML::Node node = config["networks"];
+  if (!node)
+    return;
+  if (!node.IsSequence()) {
+    problems.push_back("networks must be a list");
+    return;
+  }
+
+  network_config top = config_networks(cfg)[0];
+  for (auto it = node.begin(); it != node.end(); ++it) {
+    YAML::Node entry = *it;
+    network_config net = top;
+    try {
+      read_string(entry, "name", net.name);
+      read_string(entry, "hostname", net.hostname);
+      read_string(entry, "port", net.port);
+      read_string(entry, "server_password", net.server_password);
+      read_string(entry, "sasl_password", net.sasl_password);
+      read_string(entry, "autojoin", net.autojoin);
+      read_string(entry, "transport", net.transport);
+    } catch (YAML::Exception &e) {
+      problems.push_back(std::string("networks: ") + e.what());
+      continue;
+    }
+
+    if ((net.name.empty()) or
+        (net.name.find_first_of("/# ") != std::string::npos)) {
+      problems.push_back("networks: name \"" + net.name +
+                         "\" needs to be a word (no / # or spaces)");
+      continue;
+    }
+    if (!valid_transport(net.transport)) {
+      problems.push_back("networks: " + net.name + " transport " +
+                         net.transport + " isn't tls, tcp or unix");
+      continue;
+    }
+    bool dup = false;
+    for (auto const &other : cfg.networks)
+      dup = dup or (irc_fold(other.name) == irc_fold(net.name));
+    if (dup) {
+      problems.push_back("networks: " + net.name + " is listed twice");
+      continue;
+    }
+    cfg.networks.push_back(net);
+  }
+
+  if (cfg.networks.size() == 1)
+    cfg.networks[0].name.clear(); // just one, it doesn't need a name
+}
+
+/**
+ * @brief the networks to connect to
+ *
+ * @param cfg
+ * @return std::vector<network_config> at least one
+ */
+std::vector<network_config> config_networks(const door_config &cfg) {
+  if (!cfg.networks.empty())
+    return cfg.networks;
+  return {network_config{"", cfg.hostname, cfg.port, cfg.server_password,
+                         cfg.sasl_password, cfg.autojoin, cfg.transport}};
+}
+
+/**
+ * @brief numeric reply overrides
+ *
+ * numerics:
+ *   "311": "$1 is $2@$3"
+ *   "322": { format: "$1 $2 $t", color: list, level: 1 }
+ *
+ * Missing fields come from the built-in entry.
+ */
+static void read_numerics(YAML::Node &config,
+                          std::unordered_map<int, numeric_override> &numerics,
+                          std::vector<std::string> &problems) {
+  YAML::Node node = config["numerics"];
+  if (!node)
+    return;
+  if (!node.IsMap()) {
+    problems.push_back("numerics must be a map");
+    return;
+  }
+
+  for (auto const &kv : node) {
+    std::string key = kv.first.as<std::string>();
+    int numeric = numeric_value(key);
+    if (numeric == -1) {
+      problems.push_back("numerics: " + key + " isn't a numeric (000-999)");
+      continue;
+    }
+
+    const numeric_format &def = numeric_default(numeric);
+    numeric_override entry{def.format ? def.format : "", def.color,
+                           def.level};
+
+    try {
+      if (kv.second.IsScalar()) {
+        entry.format = kv.second.as<std::string>();
+      } else {
+        if (kv.second["format"])
+          entry.format = kv.second["format"].as<std::string>();
+        if (kv.second["color"]) {
+          std::string color = kv.second["color"].as<std::string>();
+          if (!numeric_class_name(color, entry.color))
+            problems.push_back("numerics: " + key + " unknown color " + color);
+        }
+        if (kv.second["level"])
+          entry.level = kv.second["level"].as<int>();
+      }
+    } catch (YAML::Exception &e) {
+      problems.push_back("numerics: " + key + ": " + e.what());
+      continue;
+    }
+    numerics[numeric] = entry;
+  }
+}
+
+/**
+ * @brief Parse and validate the config file.
+ *
+ * Invalid values are reported in problems, and the default is used instead.
+ *
+ * @param filename
+ * @param problems
+ * @return config_ptr nullptr if the file can't be parsed
+ */
+config_ptr load_config(const std::string &filename,
+                       std::vector<std::string> &problems) {
+  YAML::Node config;
+  try {
+    config = YAML::LoadFile(filename);
+  } catch (YAML::Exception &e) {
+    problems.push_back(filename + ": " + e.what());
+    return config_ptr{};
+  }
+
+  auto cfg = std::make_shared<door_config>();
+
+  try {
+    read_string(config, "hostname", cfg->hostname);
+    read_string(config, "port", cfg->port);
+    read_string(config, "transport", cfg->transport);
+    read_string(config, "server_password", cfg->server_password);
+    read_string(config, "sasl_password", cfg->sasl_password);
+    read_string(config, "username", cfg->username);
+    read_string(config, "realname", cfg->realname);
+    read_string(config, "autojoin", cfg->autojoin);
+    read_string(config, "log", cfg->log);
+    read_string(config, "timestamp_format", cfg->timestamp_format);
+    read_string(config, "ignore_dir", cfg->ignore_dir);
+    read_string(config, "transcript_dir", cfg->transcript_dir);
+    read_string(config, "backlog_dir", cfg->backlog_dir);
+    read_string(config, "encoding", cfg->encoding);
+    read_string(config, "input_layout", cfg->input_layout);
+    read_string(config, "theme", cfg->theme);
+    read_string(config, "trace_dir", cfg->trace_dir);
+    read_string(config, "highlight", cfg->highlight);
+  } catch (YAML::Exception &e) {
+    problems.push_back(filename + ": " + e.what());
+    return config_ptr{};
+  }
+
+  if (cfg->timestamp_format.empty()) {
+    problems.push_back("timestamp_format is empty, using %T");
+    cfg->timestamp_format = "%T";
+  }
+
+  if (!valid_transport(cfg->transport)) {
+    problems.push_back("transport " + cfg->transport +
+                       " isn't tls, tcp or unix, using tls");
+    cfg->transport = "tls";
+  }
+
+  if ((cfg->input_layout != "erase") and (cfg->input_layout != "cursor") and
+      (cfg->input_layout != "region")) {
+    problems.push_back("input_layout " + cfg->input_layout +
+                       " isn't erase, cursor or region, using erase");
+    cfg->input_layout = "erase";
+  }
+
+  if ((cfg->encoding != "auto") and (cfg->encoding != "utf8") and
+      (cfg->encoding != "cp437")) {
+    problems.push_back("encoding " + cfg->encoding + " isn't auto, utf8 or "
+                       "cp437, using auto");
+    cfg->encoding = "auto";
+  }
+
+  int allow = cfg->allow_join;
+  read_int(config, "allow_join", allow, 0, 1, problems);
+  cfg->allow_join = (allow == 1);
+
+  read_int(config, "input_delay", cfg->input_delay, 10, 5000, problems);
+  read_int(config, "max_input", cfg->max_input, 80, 4000, problems);
+  read_int(config, "backlog_lines", cfg->backlog_lines, 0, 200, problems);
+  read_int(config, "history_lines", cfg->history_lines, 0, 500, problems);
+  read_int(config, "trace_sample", cfg->trace_sample, 0, 100000, problems);
+  read_int(config, "sendq_ms", cfg->sendq_ms, 100, 10000, problems);
+  read_int(config, "paste_ms", cfg->paste_ms, 0, 1000, problems);
+  read_int(config, "paste_confirm", cfg->paste_confirm, 0, 1000, problems);
+  read_int(config, "max_queue", cfg->max_queue, 10, 100000, problems);
+  read_int(config, "log_level", cfg->log_level, 0, 2, problems);
+  read_int(config, "ping_interval", cfg->ping_interval, 0, 600, problems);
+  read_int(config, "ping_missed", cfg->ping_missed, 1, 10, problems);
+
+  read_int(config, "numeric_level", cfg->numeric_level, 0, 2, problems);
+  read_numerics(config, cfg->numerics, problems);
+  read_networks(config, *cfg, problems);
+
+  int focused = cfg->focus;
+  read_int(config, "focus", focused, 0, 1, problems);
+  cfg->focus = (focused == 1);
+
+  int reactor = cfg->single_reactor;
+  read_int(config, "single_reactor", reactor, 0, 1, problems);
+  cfg->single_reactor = (reactor == 1);
+
+  return cfg;
+}
+
+config_watcher::config_watcher(boost::asio::io_context &io_context,
+                               std::string filename, reloadFunction on_reload)
+    : filename{filename}, on_reload{on_reload},
+      signals{io_context, SIGUSR1}, notify{io_context} {
+  watch = -1;
+  std::string::size_type pos = filename.rfind('/');
+  if (pos == std::string::npos) {
+    directory = ".";
+    basename = filename;
+  } else {
+    directory = filename.substr(0, pos);
+    basename = filename.substr(pos + 1);
+  }
+}
+
+config_watcher::~config_watcher() {
+  if (notify.is_open()) {
+    if (watch != -1)
+      inotify_rm_watch(notify.native_handle(), watch);
+    notify.close();
+  }
+}
+
+void config_watcher::begin(void) {
+  signals.async_wait(std::bind(&config_watcher::on_signal, this,
+                               std::placeholders::_1, std::placeholders::_2));
+
+  // Watch the directory, not the file:  the file gets replaced by rename.
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd == -1)
+    return;
+
+  watch =
+      inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (watch == -1) {
+    close(fd);
+    return;
+  }
+
+  notify.assign(fd);
+  notify.async_read_some(boost::asio::buffer(events),
+                         std::bind(&config_watcher::on_notify, this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2));
+}
+
+/**
+ * @brief Load the config file, and publish it if it is valid.
+ *
+ * A config file that fails to parse keeps the current configuration.
+ */
+void config_watcher::reload(void) {
+  std::vector<std::string> problems;
+  config_ptr cfg = load_config(filename, problems);
+  if (cfg)
+    publish_config(cfg);
+  if (on_reload)
+    on_reload(cfg, problems);
+}
+
+void config_watcher::on_signal(const boost::system::error_code &error,
+                               int signal) {
+  if (error)
+    return;
+
+  reload();
+  signals.async_wait(std::bind(&config_watcher::on_signal, this,
+                               std::placeholders::_1, std::placeholders::_2));
+}
+
+void config_watcher::on_notify(const boost::system::error_code &error,
+                               std::size_t bytes) {
+  if (error)
+    return;
+
+  bool changed = false;
+  std::size_t pos = 0;
+  while (pos + sizeof(inotify_event) <= bytes) {
+    const inotify_event *event = (const inotify_event *)(events + pos);
+    if ((event->len > 0) and (basename == event->name))
+      changed = true;
+    pos += sizeof(inotify_event) + event->len;
+  }
+
+  if (changed)
+    reload();
+
+  notify.async_read_some(boost::asio::buffer(events),
+                         std::bind(&config_watcher::on_notify, this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2));
+}
@@ -0,0 +1,145 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <boost/asio.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "numerics.h"
+
+/**
+ * @brief One IRC network (a networks: entry)
+ *
+ * Keys missing from the entry come from the top level.
+ */
+struct network_config {
+  std::string name;
+  std::string hostname;
+  std::string port;
+  std::string server_password;
+  std::string sasl_password;
+  std::string autojoin;
+  std::string transport;
+};
+
+/**
+ * @brief Typed door configuration.
+ *
+ * Parsed and validated once from irc-door.yaml.  The connection settings are
+ * only used at startup, the tunables are re-applied when the configuration is
+ * reloaded (SIGUSR1 or the file changing).
+ */
+struct door_config {
+  // connection
+  std::string hostname = "127.0.0.1";
+  std::string port = "6697";
+  // tls, tcp (plain, for localhost) or unix (hostname is the socket path)
+  std::string transport = "tls";
+  std::string server_password;
+  std::string sasl_password;
+  std::string username = "bzbz";
+  std::string realname = "A poor soul on BZBZ BBS...";
+  std::string autojoin = "#bugz";
+  std::string log;
+  // networks: list, when it's empty config_networks() gives the one above
+  // (without a name)
+  std::vector<network_config> networks;
+  // run input and irc on one thread (door_reactor)
+  bool single_reactor = false;
+  // per user ignore lists
+  std::string ignore_dir = "ignore";
+  // per user channel transcripts (empty turns them off)
+  std::string transcript_dir = "transcripts";
+  // recent channel lines shared by the nodes (empty turns it off), and how
+  // many to show when joining
+  std::string backlog_dir = "backlog";
+  int backlog_lines = 20;
+  // lines of draft/chathistory to show when joining (0 is off)
+  int history_lines = 50;
+  // input line:  erase (redraw it around output), cursor (ANSI cursor
+  // moves) or region (pinned to the bottom row with a scroll region)
+  std::string input_layout = "erase";
+  // start in focused mode (only the talkto channel renders live)
+  bool focus = false;
+  // terminal encoding:  auto (door detection), utf8 or cp437
+  std::string encoding = "auto";
+  // render formats and colors (empty is the built-in theme)
+  std::string theme;
+  // message latency tracing:  export one in trace_sample messages (0 is
+  // off) to trace_dir/node<N>.json at exit or with /trace
+  int trace_sample = 0;
+  std::string trace_dir = "trace";
+
+  // tunables
+  bool allow_join = false;
+  int input_delay = 500;
+  // longest input line (it's split to fit when sent)
+  int max_input = 1000;
+  std::string timestamp_format = "%T";
+  int sendq_ms = 500;
+  // keys faster than paste_ms apart are a paste (0 is off), ask before
+  // sending more than paste_confirm pasted lines (0 never asks)
+  int paste_ms = 30;
+  int paste_confirm = 5;
+  int max_queue = 500;
+  int log_level = 1;
+  // lag meter PING every ping_interval seconds (0 is off), and the link is
+  // dead after ping_missed go unanswered
+  int ping_interval = 60;
+  int ping_missed = 3;
+  // extra words to highlight (besides our nick)
+  std::string highlight;
+  // numeric replies shown (numeric_level)
+  int numeric_level = NUMERIC_NORMAL;
+  // sysop changes to the numeric reply formats
+  std::unordered_map<int, numeric_override> numerics;
+};
+
+typedef std::shared_ptr<const door_config> config_ptr;
+
+bool ensure_config_defaults(const std::string &filename);
+config_ptr load_config(const std::string &filename,
+                       std::vector<std::string> &problems);
+std::vector<network_config> config_networks(const door_config &cfg);
+
+// atomic access to the active configuration
+config_ptr current_config(void);
+void publish_config(config_ptr cfg);
+
+/**
+ * @brief Reload the configuration on SIGUSR1 or when the file changes.
+ *
+ * Runs on the io_context.  on_reload is called (from the io_context) with the
+ * new configuration after it has been published.
+ */
+class config_watcher {
+public:
+  typedef std::function<void(config_ptr, std::vector<std::string> &)>
+      reloadFunction;
+
+  config_watcher(boost::asio::io_context &io_context, std::string filename,
+                 reloadFunction on_reload);
+  ~config_watcher();
+
+  void begin(void);
+  void reload(void);
+
+private:
+  void on_signal(const boost::system::error_code &error, int signal);
+  void on_notify(const boost::system::error_code &error, std::size_t bytes);
+
+  std::string filename;
+  std::string directory;
+  std::string basename;
+  reloadFunction on_reload;
+
+  boost::asio::signal_set signals;
+  boost::asio::posix::stream_descriptor notify;
+  int watch;
+  alignas(8) char events[4096];
+};
+
+#endif
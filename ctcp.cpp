@@ -0,0 +1,196 @@
+#include "ctcp.h"
+
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include <iomanip>
+
+// per host:  one reply every 10 seconds, burst of 2.
+static const double source_rate = 0.1;
+static const double source_burst = 2.0;
+// everyone:  one reply every 2 seconds, burst of 4.
+static const double global_rate = 0.5;
+static const double global_burst = 4.0;
+
+// drops before a host gets ignored, and for how long.
+static const int ctcp_strikes = 3;
+static const int all_strikes = 10;
+static const std::chrono::minutes ignore_time{5};
+// one strike wears off every strike_decay.
+static const std::chrono::minutes strike_decay{1};
+
+token_bucket::token_bucket(double rate, double burst)
+    : rate{rate}, burst{burst}, tokens{burst} {
+  last = clock::now();
+}
+
+/**
+ * @brief take a token, if we have one.
+ *
+ * @param now
+ * @return true
+ * @return false over budget
+ */
+bool token_bucket::take(clock::time_point now) {
+  std::chrono::duration<double> elapsed = now - last;
+  last = now;
+  tokens += elapsed.count() * rate;
+  if (tokens > burst)
+    tokens = burst;
+
+  if (tokens < 1.0)
+    return false;
+  tokens -= 1.0;
+  return true;
+}
+
+/**
+ * @brief give back a token that was taken, but not used
+ */
+void token_bucket::refund(void) {
+  tokens += 1.0;
+  if (tokens > burst)
+    tokens = burst;
+}
+
+/**
+ * @brief parse_host
+ *
+ * Parse out the host from nick!username@host
+ *
+ * @param name
+ * @return std::string
+ */
+std::string parse_host(const std::string &name) {
+  size_t pos = name.find('@');
+  if (pos == std::string::npos) {
+    // no host, use what we have.
+    if ((!name.empty()) and (name[0] == ':'))
+      return name.substr(1);
+    return name;
+  }
+  return name.substr(pos + 1);
+}
+
+ctcp_responder::ctcp_responder() : global{global_rate, global_burst} {
+  dropped = 0;
+  time_cached = 0;
+}
+
+void ctcp_responder::set_version(const std::string &version) {
+  version_text = " :\x01VERSION " + version + "\x01";
+}
+
+/**
+ * @brief Is this host allowed a CTCP reply?
+ *
+ * A drop because the host is over its own budget is a strike against it.
+ * Enough strikes and the host's ignore level goes up for ignore_time.  A drop
+ * because everyone is over the global budget (someone else flooding) isn't
+ * the host's fault:  no strike, and its token is given back.
+ *
+ * @param host
+ * @param now
+ * @return true
+ * @return false over budget (or ignored), drop it.
+ */
+bool ctcp_responder::allow(const std::string &host, clock::time_point now) {
+  prune(now);
+
+  auto pos = sources.find(host);
+  if (pos == sources.end())
+    pos = sources.insert({host, source{{source_rate, source_burst}}}).first;
+  source &src = pos->second;
+
+  if ((src.level > 0) and (now >= src.until)) {
+    // served their time
+    src.level = 0;
+    src.strikes = 0;
+  }
+  if (src.strikes > 0) {
+    int decay = (now - src.struck) / strike_decay;
+    if (decay > 0) {
+      src.strikes = std::max(src.strikes - decay, 0);
+      src.struck += decay * strike_decay;
+    }
+  }
+
+  // still asking while ignored is a strike too
+  bool ok = (src.level == 0) and src.bucket.take(now);
+  if ((ok) and (!global.take(now))) {
+    src.bucket.refund();
+    ++dropped;
+    return false;
+  }
+
+  if (!ok) {
+    ++dropped;
+    ++src.strikes;
+    src.struck = now;
+    if ((src.strikes >= ctcp_strikes) and (src.level < 1)) {
+      src.level = 1;
+      src.until = now + ignore_time;
+    }
+    if ((src.strikes >= all_strikes) and (src.level < 2)) {
+      src.level = 2;
+      src.until = now + ignore_time;
+    }
+  }
+  return ok;
+}
+
+int ctcp_responder::ignore_level(const std::string &host,
+                                 clock::time_point now) {
+  auto pos = sources.find(host);
+  if (pos == sources.end())
+    return 0;
+  if (now >= pos->second.until)
+    return 0;
+  return pos->second.level;
+}
+
+/**
+ * @brief forget hosts we haven't heard from in a while
+ *
+ * @param now
+ */
+void ctcp_responder::prune(clock::time_point now) {
+  if (sources.size() < 256)
+    return;
+
+  for (auto pos = sources.begin(); pos != sources.end();) {
+    if ((now >= pos->second.until) and
+        (now - pos->second.bucket.last > ignore_time))
+      pos = sources.erase(pos);
+    else
+      ++pos;
+  }
+}
+
+std::string ctcp_responder::version_reply(const std::string &to) {
+  return "NOTICE " + to + version_text;
+}
+
+std::string ctcp_responder::ping_reply(const std::string &to,
+                                       const std::string &payload) {
+  return "NOTICE " + to + " :\x01PING " + payload + "\x01";
+}
+
+/**
+ * @brief TIME reply
+ *
+ * The time string is only formatted once a second.
+ *
+ * @param to
+ * @return std::string
+ */
+std::string ctcp_responder::time_reply(const std::string &to) {
+  std::time_t now = std::time(nullptr);
+  if (now != time_cached) {
+    time_cached = now;
+    time_text = " :\x01TIME " +
+                boost::lexical_cast<std::string>(
+                    std::put_time(std::localtime(&now), "%c")) +
+                "\x01";
+  }
+  return "NOTICE " + to + time_text;
+}
@@ -0,0 +1,82 @@
+#ifndef CTCP_H
+#define CTCP_H
+
+#include "clock.h"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <string>
+
+/**
+ * @brief Token bucket rate limiter.
+ *
+ * Holds up to burst tokens, refilled at rate tokens per second.
+ */
+class token_bucket {
+public:
+  typedef irc_clock clock;
+
+  token_bucket(double rate = 1.0, double burst = 1.0);
+  bool take(clock::time_point now);
+  void refund(void);
+
+  clock::time_point last;
+
+private:
+  double rate;
+  double burst;
+  double tokens;
+};
+
+/**
+ * @brief CTCP replies, rate limited per host and globally.
+ *
+ * A CTCP flood at a channel would otherwise have every door user answer, and
+ * get the BBS killed for excess flood.  Over budget requests are dropped
+ * (and counted).  A host that keeps going over its own budget gets ignored
+ * for a while:  level 1 ignores its CTCPs, level 2 ignores everything from
+ * it.  Strikes wear off over time.
+ */
+class ctcp_responder {
+public:
+  typedef token_bucket::clock clock;
+
+  ctcp_responder();
+
+  void set_version(const std::string &version);
+
+  // check (and use) the budget for this host
+  bool allow(const std::string &host, clock::time_point now);
+  int ignore_level(const std::string &host, clock::time_point now);
+
+  // preformatted replies
+  std::string version_reply(const std::string &to);
+  std::string ping_reply(const std::string &to, const std::string &payload);
+  std::string time_reply(const std::string &to);
+
+  std::atomic<int> dropped;
+
+private:
+  struct source {
+    token_bucket bucket;
+    int strikes = 0;
+    clock::time_point struck; // last strike (or strike wearing off)
+    int level = 0;
+    clock::time_point until;
+  };
+
+  void prune(clock::time_point now);
+
+  token_bucket global;
+  std::map<std::string, source> sources;
+
+  std::string version_text;
+  std::time_t time_cached;
+  std::string time_text;
+};
+
+std::string parse_host(const std::string &name);
+
+#endif
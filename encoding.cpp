@@ -0,0 +1,223 @@
+#include "encoding.h"
+#include "door.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+terminal_encoding door_encoding = ENCODING_UTF8;
+
+// CP437 0x80 - 0xff as Unicode code points
+static const uint16_t cp437_unicode[128] = {
+    0x00c7, 0x00fc, 0x00e9, 0x00e2, 0x00e4, 0x00e0, 0x00e5, 0x00e7, // 80
+    0x00ea, 0x00eb, 0x00e8, 0x00ef, 0x00ee, 0x00ec, 0x00c4, 0x00c5, // 88
+    0x00c9, 0x00e6, 0x00c6, 0x00f4, 0x00f6, 0x00f2, 0x00fb, 0x00f9, // 90
+    0x00ff, 0x00d6, 0x00dc, 0x00a2, 0x00a3, 0x00a5, 0x20a7, 0x0192, // 98
+    0x00e1, 0x00ed, 0x00f3, 0x00fa, 0x00f1, 0x00d1, 0x00aa, 0x00ba, // a0
+    0x00bf, 0x2310, 0x00ac, 0x00bd, 0x00bc, 0x00a1, 0x00ab, 0x00bb, // a8
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556, // b0
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255d, 0x255c, 0x255b, 0x2510, // b8
+    0x2514, 0x2534, 0x252c, 0x251c, 0x2500, 0x253c, 0x255e, 0x255f, // c0
+    0x255a, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256c, 0x2567, // c8
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256b, // d0
+    0x256a, 0x2518, 0x250c, 0x2588, 0x2584, 0x258c, 0x2590, 0x2580, // d8
+    0x03b1, 0x00df, 0x0393, 0x03c0, 0x03a3, 0x03c3, 0x00b5, 0x03c4, // e0
+    0x03a6, 0x0398, 0x03a9, 0x03b4, 0x221e, 0x03c6, 0x03b5, 0x2229, // e8
+    0x2261, 0x00b1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00f7, 0x2248, // f0
+    0x00b0, 0x2219, 0x00b7, 0x221a, 0x207f, 0x00b2, 0x25a0, 0x00a0, // f8
+};
+
+// close enough, for code points CP437 doesn't have
+static const std::pair<uint16_t, uint8_t> cp437_near[] = {
+    {0x00a6, '|'},  {0x00a9, 'c'},  {0x00ae, 'r'},  {0x00b3, '3'},
+    {0x00b4, '\''}, {0x00b8, ','},  {0x00b9, '1'},  {0x00be, '?'},
+    {0x2010, '-'},  {0x2011, '-'},  {0x2012, '-'},  {0x2013, '-'},
+    {0x2014, '-'},  {0x2015, '-'},  {0x2018, '\''}, {0x2019, '\''},
+    {0x201a, ','},  {0x201b, '\''}, {0x201c, '"'},  {0x201d, '"'},
+    {0x201e, '"'},  {0x2022, 0xf9}, {0x2032, '\''}, {0x2033, '"'},
+    {0x2039, '<'},  {0x203a, '>'},  {0x20ac, 'E'},  {0x2122, 'T'},
+    {0x2190, '<'},  {0x2192, '>'},  {0x2212, '-'},  {0x2215, '/'},
+    {0x2260, '='},  {0x2713, 0xfb}, {0x2714, 0xfb},
+};
+
+// U+00C0 - U+00FF without their accents
+static const char latin1_base[] = "AAAAAAACEEEEIIII"
+                                  "DNOOOOOxOUUUUYPs"
+                                  "aaaaaaaceeeeiiii"
+                                  "dnooooo/ouuuuypy";
+
+/**
+ * @brief code point to CP437 lookup, sorted by code point
+ */
+static const std::vector<std::pair<uint16_t, uint8_t>> &cp437_lookup(void) {
+  static const std::vector<std::pair<uint16_t, uint8_t>> table = []() {
+    std::vector<std::pair<uint16_t, uint8_t>> t;
+    for (int x = 0; x < 128; ++x)
+      t.emplace_back(cp437_unicode[x], (uint8_t)(0x80 + x));
+    for (auto const &near : cp437_near)
+      t.push_back(near);
+    std::sort(t.begin(), t.end());
+    return t;
+  }();
+  return table;
+}
+
+/**
+ * @brief one (non-ASCII) code point to CP437
+ *
+ * @param cp
+ * @param output
+ */
+static void cp437_append(uint32_t cp, std::string &output) {
+  // zero width:  combining marks, joiners, byte order mark
+  if (((cp >= 0x0300) and (cp <= 0x036f)) or
+      ((cp >= 0x200b) and (cp <= 0x200f)) or (cp == 0xfe0f) or (cp == 0xfeff))
+    return;
+
+  if (cp <= 0xffff) {
+    auto &table = cp437_lookup();
+    auto pos = std::lower_bound(
+        table.begin(), table.end(), std::make_pair((uint16_t)cp, (uint8_t)0));
+    if ((pos != table.end()) and (pos->first == cp)) {
+      output += (char)pos->second;
+      return;
+    }
+  }
+
+  if ((cp >= 0x00c0) and (cp <= 0x00ff)) {
+    output += latin1_base[cp - 0x00c0];
+    return;
+  }
+  if (cp == 0x2026) {
+    output += "...";
+    return;
+  }
+  if ((cp >= 0x2500) and (cp <= 0x257f)) {
+    // a box drawing piece CP437 doesn't have
+    output += '+';
+    return;
+  }
+  output += '?';
+}
+
+/**
+ * @brief UTF-8 to CP437
+ *
+ * Runs of ASCII are copied as they are (8 bytes at a time while looking for
+ * them).  Anything CP437 has is mapped, accented Latin-1 letters lose their
+ * accents, and the rest becomes '?'.  Invalid UTF-8 bytes are '?' too.
+ *
+ * @param text
+ * @return std::string
+ */
+std::string utf8_to_cp437(const std::string &text) {
+  const unsigned char *data = (const unsigned char *)text.data();
+  size_t size = text.size();
+  size_t pos = 0;
+
+  // nothing to do?
+  while (pos + 8 <= size) {
+    uint64_t chunk;
+    memcpy(&chunk, data + pos, 8);
+    if (chunk & 0x8080808080808080ULL)
+      break;
+    pos += 8;
+  }
+  while ((pos < size) and (data[pos] < 0x80))
+    ++pos;
+  if (pos == size)
+    return text;
+
+  std::string output;
+  output.reserve(size);
+  output.append(text, 0, pos);
+
+  while (pos < size) {
+    size_t run = pos;
+    while ((run < size) and (data[run] < 0x80))
+      ++run;
+    if (run > pos) {
+      output.append(text, pos, run - pos);
+      pos = run;
+      if (pos == size)
+        break;
+    }
+
+    unsigned char c = data[pos];
+    int length = (c >= 0xf0) ? 4 : (c >= 0xe0) ? 3 : (c >= 0xc0) ? 2 : 0;
+    uint32_t cp = (length == 4) ? (c & 0x07) : (length == 3) ? (c & 0x0f)
+                                                             : (c & 0x1f);
+    bool valid = (length != 0) and (c < 0xf8) and (pos + length <= size);
+    for (int x = 1; valid and (x < length); ++x) {
+      if ((data[pos + x] & 0xc0) != 0x80)
+        valid = false;
+      else
+        cp = (cp << 6) | (data[pos + x] & 0x3f);
+    }
+
+    if (!valid) {
+      output += '?';
+      ++pos;
+      continue;
+    }
+    cp437_append(cp, output);
+    pos += length;
+  }
+  return output;
+}
+
+/**
+ * @brief CP437 to UTF-8
+ *
+ * @param text
+ * @return std::string
+ */
+std::string cp437_to_utf8(const std::string &text) {
+  std::string output;
+  output.reserve(text.size());
+
+  for (unsigned char c : text) {
+    if (c < 0x80) {
+      output += (char)c;
+      continue;
+    }
+    uint16_t cp = cp437_unicode[c - 0x80];
+    if (cp < 0x800) {
+      output += (char)(0xc0 | (cp >> 6));
+      output += (char)(0x80 | (cp & 0x3f));
+    } else {
+      output += (char)(0xe0 | (cp >> 12));
+      output += (char)(0x80 | ((cp >> 6) & 0x3f));
+      output += (char)(0x80 | (cp & 0x3f));
+    }
+  }
+  return output;
+}
+
+/**
+ * @brief the encoding for the encoding config setting
+ *
+ * @param setting auto (from the door's terminal detection), utf8 or cp437
+ * @return terminal_encoding
+ */
+terminal_encoding select_encoding(const std::string &setting) {
+  if (setting == "utf8")
+    return ENCODING_UTF8;
+  if (setting == "cp437")
+    return ENCODING_CP437;
+  return door::unicode ? ENCODING_UTF8 : ENCODING_CP437;
+}
+
+std::string to_terminal(const std::string &text) {
+  if (door_encoding == ENCODING_CP437)
+    return utf8_to_cp437(text);
+  return text;
+}
+
+std::string from_terminal(const std::string &text) {
+  if (door_encoding == ENCODING_CP437)
+    return cp437_to_utf8(text);
+  return text;
+}
@@ -0,0 +1,26 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <string>
+
+/**
+ * @brief What the caller's terminal understands.
+ *
+ * IRC text is UTF-8.  For CP437 terminals, render output is transcoded to
+ * CP437 (one byte per column, so the width math works), and what they type
+ * is transcoded back to UTF-8 before it's sent.
+ */
+enum terminal_encoding { ENCODING_UTF8, ENCODING_CP437 };
+
+extern terminal_encoding door_encoding;
+
+terminal_encoding select_encoding(const std::string &setting);
+
+std::string utf8_to_cp437(const std::string &text);
+std::string cp437_to_utf8(const std::string &text);
+
+// render output, and keyboard input, for door_encoding
+std::string to_terminal(const std::string &text);
+std::string from_terminal(const std::string &text);
+
+#endif
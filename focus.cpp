@@ -0,0 +1,133 @@
+#include "focus.h"
+#include "complete.h"
+#include "networks.h"
+#include "render.h"
+
+focus_buffers focus;
+
+/**
+ * @brief focused mode on or off
+ *
+ * Turning it off shows everything that was held.  The input line must
+ * already be cleared.
+ *
+ * @param door
+ * @param on
+ */
+void focus_buffers::enable(door::Door &door, bool on) {
+  focused = on;
+  if (on)
+    return;
+
+  for (auto &h : held)
+    render_held(door, *h.first.first, h.second);
+  held.clear();
+}
+
+/**
+ * @brief hold msg, if it's for a channel we're not looking at
+ *
+ * @param msg moved from when it's held
+ * @param irc the network it's from
+ * @return true it was held
+ */
+bool focus_buffers::hold(message_ptr &msg, ircClient &irc) {
+  if ((!focused) or (msg->highlight) or (msg->size() < 3))
+    return false;
+
+  switch (msg->cmd) {
+  case CMD_PRIVMSG:
+  case CMD_ACTION:
+  case CMD_NOTICE:
+  case CMD_JOIN:
+  case CMD_PART:
+  case CMD_KICK:
+  case CMD_TOPIC:
+  case CMD_MODE:
+    break;
+  default:
+    return false;
+  }
+
+  if (*msg->data(2) != '#')
+    return false;
+
+  std::string channel = msg->part(2);
+  std::string name = irc_fold(channel);
+  if ((&irc == &networks.active()) and (name == irc_fold(irc.talkto())))
+    return false;
+
+  held_channel &h = held[channel_key{&irc, name}];
+  h.channel = channel;
+  if ((msg->cmd == CMD_PRIVMSG) or (msg->cmd == CMD_ACTION) or
+      (msg->cmd == CMD_NOTICE))
+    ++h.unread;
+  h.messages.push_back(std::move(msg));
+  if (h.messages.size() > MAX_HELD) {
+    h.messages.pop_front();
+    ++h.dropped;
+  }
+  return true;
+}
+
+void focus_buffers::render_held(door::Door &door, ircClient &irc,
+                                held_channel &h) {
+  door::ANSIColor info{door::COLOR::CYAN};
+
+  door << info << "-- " << irc.display_name(h.channel) << ", " << h.unread
+       << " unread";
+  if (h.dropped)
+    door << " (" << h.dropped << " older not shown)";
+  door << " --" << door::reset << door::nl;
+
+  for (auto &msg : h.messages)
+    render(*msg, door, irc);
+}
+
+/**
+ * @brief show what was held for the talkto channel (if anything)
+ *
+ * @param door input line must already be cleared
+ * @param irc
+ */
+void focus_buffers::show(door::Door &door, ircClient &irc) {
+  auto pos = held.find(channel_key{&irc, irc_fold(irc.talkto())});
+  if (pos == held.end())
+    return;
+  render_held(door, irc, pos->second);
+  held.erase(pos);
+}
+
+/**
+ * @brief is anything held for the talkto channel?
+ */
+bool focus_buffers::waiting(ircClient &irc) {
+  if ((held.empty()) or (&irc != &networks.active()))
+    return false;
+  return held.find(channel_key{&irc, irc_fold(irc.talkto())}) != held.end();
+}
+
+int focus_buffers::unread(void) const {
+  int total = 0;
+  for (auto const &h : held)
+    total += h.second.unread;
+  return total;
+}
+
+/**
+ * @brief the next channel with unread messages
+ *
+ * @param irc set to its network
+ * @param channel set to the channel
+ * @return true found one
+ */
+bool focus_buffers::next(ircClient *&irc, std::string &channel) const {
+  for (auto const &h : held) {
+    if (h.second.unread == 0)
+      continue;
+    irc = h.first.first;
+    channel = h.second.channel;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,53 @@
+#ifndef FOCUS_H
+#define FOCUS_H
+
+#include "door.h"
+#include "irc.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+
+/**
+ * @brief Focused mode:  only the talkto channel renders live.
+ *
+ * Channel traffic for the other channels is held (per network and
+ * channel, up to MAX_HELD messages) until we talkto that channel.  Private
+ * messages, highlights and system messages always render.  Render thread
+ * only.
+ */
+class focus_buffers {
+public:
+  static const size_t MAX_HELD = 200;
+
+  bool enabled(void) const { return focused; }
+  void enable(door::Door &door, bool on);
+
+  bool hold(message_ptr &msg, ircClient &irc);
+  bool waiting(ircClient &irc);
+  void show(door::Door &door, ircClient &irc);
+  int unread(void) const;
+  bool next(ircClient *&irc, std::string &channel) const;
+  // before exit, the messages go back to the pool
+  void end_session(void) { held.clear(); }
+
+private:
+  typedef std::pair<ircClient *, std::string> channel_key;
+
+  struct held_channel {
+    std::string channel;
+    std::deque<message_ptr> messages;
+    int unread = 0;
+    int dropped = 0;
+  };
+
+  void render_held(door::Door &door, ircClient &irc, held_channel &held);
+
+  bool focused = false;
+  std::map<channel_key, held_channel> held;
+};
+
+extern focus_buffers focus;
+
+#endif
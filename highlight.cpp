@@ -0,0 +1,135 @@
+#include "highlight.h"
+#include "complete.h"
+
+#include <cctype>
+#include <cstring>
+#include <queue>
+
+/**
+ * @brief fold one character (rfc1459)
+ */
+static inline char fold(char c) {
+  if ((c >= 'A') and (c <= '^'))
+    return c + ('a' - 'A');
+  return c;
+}
+
+/**
+ * @brief can this character be part of a nick/word?
+ */
+static inline bool word_char(char c) {
+  if (isalnum((unsigned char)c))
+    return true;
+  return std::strchr("_-[]\\`^{}|", c) != nullptr;
+}
+
+keyword_matcher::keyword_matcher(const std::vector<std::string> &keywords) {
+  nodes.push_back(node{});
+
+  // build the trie
+  for (auto const &keyword : keywords) {
+    if (keyword.empty())
+      continue;
+    std::string folded = irc_fold(keyword);
+    int state = 0;
+    for (char c : folded) {
+      int next = child(state, c);
+      if (next == -1) {
+        next = (int)nodes.size();
+        nodes[state].next.push_back({c, next});
+        nodes.push_back(node{});
+      }
+      state = next;
+    }
+    nodes[state].found.push_back((int)folded.size());
+  }
+
+  // breadth first, to set the fail links
+  std::queue<int> todo;
+  for (auto const &n : nodes[0].next) {
+    nodes[n.second].fail = 0;
+    todo.push(n.second);
+  }
+
+  while (!todo.empty()) {
+    int state = todo.front();
+    todo.pop();
+
+    for (auto const &n : nodes[state].next) {
+      int fail = step(nodes[state].fail, n.first);
+      nodes[n.second].fail = fail;
+      for (int len : nodes[fail].found)
+        nodes[n.second].found.push_back(len);
+      todo.push(n.second);
+    }
+  }
+}
+
+int keyword_matcher::child(int state, char c) const {
+  for (auto const &n : nodes[state].next) {
+    if (n.first == c)
+      return n.second;
+  }
+  return -1;
+}
+
+int keyword_matcher::step(int state, char c) const {
+  while (true) {
+    int next = child(state, c);
+    if (next != -1)
+      return next;
+    if (state == 0)
+      return 0;
+    state = nodes[state].fail;
+  }
+}
+
+/**
+ * @brief does text contain any of the keywords (as a whole word)?
+ *
+ * @param text
+ * @return true
+ */
+bool keyword_matcher::match(const std::string &text) const {
+  if (empty())
+    return false;
+
+  int state = 0;
+  int size = (int)text.size();
+
+  for (int pos = 0; pos < size; ++pos) {
+    state = step(state, fold(text[pos]));
+
+    for (int len : nodes[state].found) {
+      int start = pos + 1 - len;
+      bool left = (start == 0) or (!word_char(text[start - 1]));
+      bool right = (pos + 1 == size) or (!word_char(text[pos + 1]));
+      if (left and right)
+        return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief split on spaces and commas
+ *
+ * @param text
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> split_words(const std::string &text) {
+  std::vector<std::string> words;
+  std::string word;
+  for (char c : text) {
+    if ((c == ' ') or (c == ',')) {
+      if (!word.empty())
+        words.push_back(word);
+      word.clear();
+    } else {
+      word += c;
+    }
+  }
+  if (!word.empty())
+    words.push_back(word);
+  return words;
+}
@@ -0,0 +1,40 @@
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Multi-keyword matcher (Aho-Corasick)
+ *
+ * All of the keywords are found in one pass over the text, no matter how many
+ * there are.  Matching is case-folded (rfc1459) and only counts whole words,
+ * so "bob" matches "bob:" but not "bobby".
+ */
+class keyword_matcher {
+public:
+  keyword_matcher(const std::vector<std::string> &keywords);
+
+  bool empty(void) const { return nodes.size() == 1; }
+  bool match(const std::string &text) const;
+
+private:
+  struct node {
+    std::vector<std::pair<char, int>> next;
+    int fail = 0;
+    // lengths of the keywords ending here (including via fail links)
+    std::vector<int> found;
+  };
+
+  int child(int state, char c) const;
+  int step(int state, char c) const;
+
+  std::vector<node> nodes;
+};
+
+typedef std::shared_ptr<const keyword_matcher> highlight_ptr;
+
+std::vector<std::string> split_words(const std::string &text);
+
+#endif
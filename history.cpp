@@ -0,0 +1,210 @@
+#include "history.h"
+#include "complete.h"
+#include "irc.h" // parse_nick
+#include "message.h"
+
+#include <cstdio>
+
+/**
+ * @brief unescape a message tag value
+ */
+static std::string tag_value(const std::string &value) {
+  std::string result;
+  result.reserve(value.size());
+  for (size_t x = 0; x < value.size(); ++x) {
+    if ((value[x] != '\\') or (x + 1 == value.size())) {
+      if (value[x] != '\\')
+        result += value[x];
+      continue;
+    }
+    char c = value[++x];
+    if (c == ':')
+      result += ';';
+    else if (c == 's')
+      result += ' ';
+    else if (c == 'r')
+      result += '\r';
+    else if (c == 'n')
+      result += '\n';
+    else
+      result += c;
+  }
+  return result;
+}
+
+/**
+ * @brief parse and remove the message tags (@a=b;c=d ) from text
+ *
+ * @param text the line, without its tags afterwards
+ * @param tags
+ * @return true there were tags
+ */
+bool irc_tags(std::string &text, message_tags &tags) {
+  if ((text.empty()) or (text[0] != '@'))
+    return false;
+
+  size_t space = text.find(' ');
+  if (space == std::string::npos)
+    space = text.size();
+  std::string all = text.substr(1, space - 1);
+  space = text.find_first_not_of(' ', space);
+  text.erase(0, space);
+
+  size_t pos = 0;
+  while (pos < all.size()) {
+    size_t end = all.find(';', pos);
+    if (end == std::string::npos)
+      end = all.size();
+    size_t equal = all.find('=', pos);
+    if ((equal != std::string::npos) and (equal < end)) {
+      std::string key = all.substr(pos, equal - pos);
+      std::string value = all.substr(equal + 1, end - equal - 1);
+      if (key == "msgid")
+        tags.msgid = tag_value(value);
+      else if (key == "batch")
+        tags.batch = tag_value(value);
+      else if (key == "time")
+        tags.time = parse_server_time(value);
+    }
+    pos = end + 1;
+  }
+  return true;
+}
+
+/**
+ * @brief server-time (2021-06-01T12:34:56.789Z) to time_t
+ *
+ * @param value
+ * @return std::time_t 0 if it doesn't parse
+ */
+std::time_t parse_server_time(const std::string &value) {
+  struct tm tm {};
+  if (sscanf(value.c_str(), "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon,
+             &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+    return 0;
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  return timegm(&tm);
+}
+
+void history_batches::open(const std::string &ref,
+                           const std::string &channel) {
+  batch &b = pending[ref];
+  b.block = std::make_shared<history_block>();
+  b.block->channel = channel;
+  b.msgids.clear();
+}
+
+/**
+ * @brief a line inside an open batch
+ *
+ * Only channel text is kept (CTCP ACTION is unwrapped).
+ */
+void history_batches::add(const std::string &ref,
+                          const std::vector<std::string> &parts,
+                          const message_tags &tags) {
+  auto pos = pending.find(ref);
+  if ((pos == pending.end()) or (parts.size() < 4))
+    return;
+
+  message_cmd cmd = message_command(parts[1]);
+  if ((cmd != CMD_PRIVMSG) and (cmd != CMD_NOTICE))
+    return;
+
+  history_line line;
+  line.stamp = tags.time ? tags.time : irc_clock::wall();
+  line.cmd = cmd;
+  line.nick = parse_nick(parts[0]);
+  line.text = parts[parts.size() - 1];
+
+  if ((!line.text.empty()) and (line.text[0] == '\x01')) {
+    if (line.text.compare(0, 8, "\x01" "ACTION ") != 0)
+      return;
+    line.text.erase(0, 8);
+    if ((!line.text.empty()) and (line.text[line.text.size() - 1] == '\x01'))
+      line.text.erase(line.text.size() - 1);
+    line.cmd = CMD_ACTION;
+  }
+
+  pos->second.block->lines.push_back(std::move(line));
+  pos->second.msgids.push_back(tags.msgid);
+}
+
+static std::string line_key(std::time_t stamp, const std::string &nick,
+                            const std::string &text) {
+  return std::to_string(stamp) + " " + nick + " " + text;
+}
+
+bool history_batches::was_seen(const seen_set &s, const std::string &msgid,
+                               const history_line &line) const {
+  if ((!msgid.empty()) and (s.keys.count("@" + msgid) != 0))
+    return true;
+  return s.keys.count(line_key(line.stamp, line.nick, line.text)) != 0;
+}
+
+void history_batches::remember(seen_set &s, const std::string &key) {
+  if (!s.keys.insert(key).second)
+    return;
+  s.order.push_back(key);
+  if (s.order.size() > MAX_SEEN) {
+    s.keys.erase(s.order.front());
+    s.order.pop_front();
+  }
+}
+
+/**
+ * @brief BATCH -ref
+ *
+ * @param ref
+ * @param budget most lines to keep (the newest)
+ * @return history_ptr null if ref wasn't ours
+ */
+history_ptr history_batches::close(const std::string &ref, size_t budget) {
+  auto pos = pending.find(ref);
+  if (pos == pending.end())
+    return history_ptr{};
+
+  std::shared_ptr<history_block> block = pos->second.block;
+  std::vector<std::string> msgids;
+  msgids.swap(pos->second.msgids);
+  pending.erase(pos);
+
+  seen_set &s = shown[irc_fold(block->channel)];
+  std::vector<history_line> lines;
+  lines.reserve(block->lines.size());
+
+  for (size_t x = 0; x < block->lines.size(); ++x) {
+    history_line &line = block->lines[x];
+    if (was_seen(s, msgids[x], line)) {
+      ++block->duplicates;
+      continue;
+    }
+    if (!msgids[x].empty())
+      remember(s, "@" + msgids[x]);
+    remember(s, line_key(line.stamp, line.nick, line.text));
+    lines.push_back(std::move(line));
+  }
+
+  if (lines.size() > budget) {
+    block->skipped = (int)(lines.size() - budget);
+    lines.erase(lines.begin(), lines.begin() + block->skipped);
+  }
+  block->lines.swap(lines);
+  return block;
+}
+
+/**
+ * @brief a channel line was shown
+ */
+void history_batches::seen(const std::string &channel,
+                           const std::string &msgid, std::time_t stamp,
+                           const std::string &nick, const std::string &text) {
+  seen_set &s = shown[irc_fold(channel)];
+  if (!msgid.empty())
+    remember(s, "@" + msgid);
+  remember(s, line_key(stamp, nick, text));
+}
+
+void history_batches::forget(const std::string &channel) {
+  shown.erase(irc_fold(channel));
+}
@@ -0,0 +1,88 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <ctime>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief IRCv3 message tags we use
+ */
+struct message_tags {
+  std::string msgid;
+  std::string batch;
+  std::time_t time = 0; // server-time, 0 when missing
+};
+
+bool irc_tags(std::string &text, message_tags &tags);
+std::time_t parse_server_time(const std::string &value);
+
+struct history_line {
+  std::time_t stamp;
+  int cmd; // message_cmd
+  std::string nick;
+  std::string text;
+};
+
+/**
+ * @brief A finished chathistory batch, ready to render as one block
+ */
+struct history_block {
+  std::string channel;
+  std::vector<history_line> lines;
+  // lines we had already shown, and lines over the budget
+  int duplicates = 0;
+  int skipped = 0;
+};
+
+typedef std::shared_ptr<const history_block> history_ptr;
+
+/**
+ * @brief Collects draft/chathistory batches (io_context thread)
+ *
+ * Lines in a batch are held until BATCH -ref, then the lines we've already
+ * shown (by msgid, or time + nick + text) are dropped, and only the newest
+ * budget lines are kept.  Channel lines as they're shown go through seen(),
+ * so history arriving after them doesn't repeat them.
+ */
+class history_batches {
+public:
+  static const size_t MAX_SEEN = 500; // per channel
+
+  void open(const std::string &ref, const std::string &channel);
+  bool is_open(const std::string &ref) const {
+    return pending.find(ref) != pending.end();
+  }
+  void add(const std::string &ref, const std::vector<std::string> &parts,
+           const message_tags &tags);
+  history_ptr close(const std::string &ref, size_t budget);
+
+  void seen(const std::string &channel, const std::string &msgid,
+            std::time_t stamp, const std::string &nick,
+            const std::string &text);
+  void forget(const std::string &channel);
+
+private:
+  struct batch {
+    std::shared_ptr<history_block> block;
+    std::vector<std::string> msgids;
+  };
+
+  struct seen_set {
+    std::unordered_set<std::string> keys;
+    std::deque<std::string> order;
+  };
+
+  bool was_seen(const seen_set &s, const std::string &msgid,
+                const history_line &line) const;
+  void remember(seen_set &s, const std::string &key);
+
+  std::map<std::string, batch> pending;
+  std::map<std::string, seen_set> shown;
+};
+
+#endif
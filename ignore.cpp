@@ -0,0 +1,381 @@
+#include "ignore.h"
+#include "complete.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ignore_list user_ignores;
+
+static const struct {
+  const char *name;
+  unsigned type;
+} type_names[] = {
+    {"msg", IGNORE_PRIVMSG},   {"notice", IGNORE_NOTICE},
+    {"ctcp", IGNORE_CTCP},     {"action", IGNORE_ACTION},
+    {"joins", IGNORE_JOINS},   {"all", IGNORE_ALL},
+};
+
+/**
+ * @brief parse type names "msg,notice"
+ *
+ * @param names
+ * @return unsigned 0 if any name is unknown
+ */
+unsigned ignore_types(const std::string &names) {
+  unsigned types = 0;
+  std::stringstream ss(names);
+  std::string name;
+
+  while (std::getline(ss, name, ',')) {
+    bool found = false;
+    for (auto const &tn : type_names) {
+      if (name == tn.name) {
+        types |= tn.type;
+        found = true;
+      }
+    }
+    if (!found)
+      return 0;
+  }
+  return types;
+}
+
+std::string ignore_names(unsigned types) {
+  if (types == IGNORE_ALL)
+    return "all";
+
+  std::string names;
+  for (auto const &tn : type_names) {
+    if ((tn.type != IGNORE_ALL) and (types & tn.type)) {
+      if (!names.empty())
+        names += ",";
+      names += tn.name;
+    }
+  }
+  return names;
+}
+
+unsigned ignore_kind(const std::string &cmd, const std::string &msg) {
+  if (cmd == "PRIVMSG") {
+    if ((!msg.empty()) and (msg[0] == '\x01')) {
+      if (msg.compare(1, 7, "ACTION ") == 0)
+        return IGNORE_ACTION;
+      return IGNORE_CTCP;
+    }
+    return IGNORE_PRIVMSG;
+  }
+  if (cmd == "NOTICE")
+    return IGNORE_NOTICE;
+  if ((cmd == "JOIN") or (cmd == "PART") or (cmd == "KICK") or
+      (cmd == "QUIT") or (cmd == "NICK"))
+    return IGNORE_JOINS;
+  return 0;
+}
+
+/**
+ * @brief make a full nick!user@host mask
+ *
+ * "nick" => "nick!*@*", "user@host" => "*!user@host"
+ *
+ * @param mask
+ * @return std::string
+ */
+std::string normalize_mask(const std::string &mask) {
+  bool bang = (mask.find('!') != std::string::npos);
+  bool at = (mask.find('@') != std::string::npos);
+
+  if (bang and at)
+    return mask;
+  if (at)
+    return "*!" + mask;
+  if (bang)
+    return mask + "@*";
+  return mask + "!*@*";
+}
+
+static bool has_wildcard(const std::string &text) {
+  return text.find_first_of("*?") != std::string::npos;
+}
+
+glob::glob(const std::string &pattern) {
+  anchor_start = pattern.empty() or (pattern[0] != '*');
+  anchor_end = pattern.empty() or (pattern[pattern.size() - 1] != '*');
+
+  std::string segment;
+  for (char c : pattern) {
+    if (c == '*') {
+      if (!segment.empty())
+        segments.push_back(segment);
+      segment.clear();
+    } else {
+      segment += c;
+    }
+  }
+  if (!segment.empty())
+    segments.push_back(segment);
+
+  if ((pattern.find('*') == std::string::npos) and segments.empty())
+    segments.push_back(std::string());
+}
+
+/**
+ * @brief does segment match text at pos? ('?' matches any character)
+ */
+bool glob::match_at(const std::string &segment, const std::string &text,
+                    size_t pos) const {
+  if (pos + segment.size() > text.size())
+    return false;
+  for (size_t x = 0; x < segment.size(); ++x) {
+    if ((segment[x] != '?') and (segment[x] != text[pos + x]))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief match text against the glob
+ *
+ * The first and last segments are anchored (unless the pattern starts/ends
+ * with '*'), the middle segments match at their earliest position.
+ *
+ * @param text
+ * @return true
+ */
+bool glob::match(const std::string &text) const {
+  if (anchor_start and anchor_end and (segments.size() == 1)) {
+    // no '*' at all
+    return (text.size() == segments[0].size()) and
+           match_at(segments[0], text, 0);
+  }
+
+  size_t pos = 0;
+  size_t end = text.size();
+  size_t first = 0;
+  size_t last = segments.size();
+
+  if (anchor_start and (first < last)) {
+    if (!match_at(segments[first], text, 0))
+      return false;
+    pos = segments[first].size();
+    ++first;
+  }
+
+  if (anchor_end and (first < last)) {
+    const std::string &segment = segments[last - 1];
+    if (segment.size() > end - pos)
+      return false;
+    if (!match_at(segment, text, end - segment.size()))
+      return false;
+    end -= segment.size();
+    --last;
+  }
+
+  for (size_t s = first; s < last; ++s) {
+    const std::string &segment = segments[s];
+    bool found = false;
+    while (pos + segment.size() <= end) {
+      if (match_at(segment, text, pos)) {
+        found = true;
+        break;
+      }
+      ++pos;
+    }
+    if (!found)
+      return false;
+    pos += segment.size();
+  }
+  return true;
+}
+
+ignore_matcher::ignore_matcher(const std::vector<ignore_rule> &rules) {
+  count = 0;
+
+  for (auto const &rule : rules) {
+    std::string mask = irc_fold(normalize_mask(rule.mask));
+    entry e{rule.types, irc_fold(rule.channel)};
+    ++count;
+
+    size_t bang = mask.find('!');
+    size_t at = mask.find('@', bang);
+    std::string nick = mask.substr(0, bang);
+    std::string user = mask.substr(bang + 1, at - bang - 1);
+    std::string host = mask.substr(at + 1);
+
+    if (!has_wildcard(mask)) {
+      exact[mask].push_back(e);
+    } else if ((user == "*") and (host == "*") and (!has_wildcard(nick))) {
+      nicks[nick].push_back(e);
+    } else if ((nick == "*") and (user == "*") and (!has_wildcard(host))) {
+      hosts[host].push_back(e);
+    } else {
+      globs.push_back({glob(mask), e});
+    }
+  }
+}
+
+unsigned ignore_matcher::types_for(const std::vector<entry> &entries,
+                                   const std::string &channel) {
+  unsigned types = 0;
+  for (auto const &e : entries) {
+    if ((e.channel.empty()) or (e.channel == channel))
+      types |= e.types;
+  }
+  return types;
+}
+
+/**
+ * @brief ignored message types for this source
+ *
+ * @param prefix :nick!user@host
+ * @param channel target (for per-channel rules)
+ * @return unsigned ignore_type bits
+ */
+unsigned ignore_matcher::match(const std::string &prefix,
+                               const std::string &channel) const {
+  if (count == 0)
+    return 0;
+
+  std::string source = irc_fold(prefix);
+  if ((!source.empty()) and (source[0] == ':'))
+    source.erase(0, 1);
+  std::string chan = irc_fold(channel);
+
+  unsigned types = 0;
+  auto pos = exact.find(source);
+  if (pos != exact.end())
+    types |= types_for(pos->second, chan);
+
+  size_t bang = source.find('!');
+  pos = nicks.find(source.substr(0, bang));
+  if (pos != nicks.end())
+    types |= types_for(pos->second, chan);
+
+  size_t at = source.find('@');
+  if (at != std::string::npos) {
+    pos = hosts.find(source.substr(at + 1));
+    if (pos != hosts.end())
+      types |= types_for(pos->second, chan);
+  }
+
+  for (auto const &g : globs) {
+    if ((g.second.types & ~types) == 0)
+      continue;
+    if (((g.second.channel.empty()) or (g.second.channel == chan)) and
+        (g.first.match(source)))
+      types |= g.second.types;
+  }
+  return types;
+}
+
+/**
+ * @brief load the rules
+ *
+ * One rule per line:  mask types [#channel]
+ *
+ * @param filename
+ */
+void ignore_list::load(const std::string &filename) {
+  this->filename = filename;
+  list.clear();
+
+  std::ifstream f(filename.c_str());
+  std::string line;
+  while (std::getline(f, line)) {
+    std::stringstream ss(line);
+    ignore_rule rule;
+    std::string types;
+    ss >> rule.mask >> types >> rule.channel;
+    rule.types = ignore_types(types);
+    if ((!rule.mask.empty()) and (rule.types != 0))
+      list.push_back(rule);
+  }
+}
+
+bool ignore_list::save(void) {
+  if (filename.empty())
+    return false;
+
+  // the same handle can be on more than one node
+  std::string tempname =
+      filename + "." + std::to_string(getpid()) + ".tmp";
+  {
+    std::ofstream f(tempname.c_str());
+    for (auto const &rule : list) {
+      f << rule.mask << " " << ignore_names(rule.types);
+      if (!rule.channel.empty())
+        f << " " << rule.channel;
+      f << std::endl;
+    }
+    if (!f.good()) {
+      std::remove(tempname.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tempname.c_str(), filename.c_str()) != 0) {
+    std::remove(tempname.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief add (or replace) a rule
+ *
+ * @param mask
+ * @param types
+ * @param channel
+ * @return std::string the normalized mask
+ */
+std::string ignore_list::add(const std::string &mask, unsigned types,
+                             const std::string &channel) {
+  std::string full = normalize_mask(mask);
+  for (auto &rule : list) {
+    if ((irc_fold(rule.mask) == irc_fold(full)) and
+        (irc_fold(rule.channel) == irc_fold(channel))) {
+      rule.types = types;
+      return full;
+    }
+  }
+  list.push_back(ignore_rule{full, types, channel});
+  return full;
+}
+
+bool ignore_list::remove(const std::string &mask) {
+  std::string full = irc_fold(normalize_mask(mask));
+  bool found = false;
+  for (auto pos = list.begin(); pos != list.end();) {
+    if (irc_fold(pos->mask) == full) {
+      pos = list.erase(pos);
+      found = true;
+    } else
+      ++pos;
+  }
+  return found;
+}
+
+/**
+ * @brief the ignore filename for this user
+ *
+ * Creates the directory if needed.  Anything odd in the handle becomes '_'.
+ *
+ * @param directory
+ * @param handle
+ * @return std::string
+ */
+std::string ignore_filename(const std::string &directory,
+                            const std::string &handle) {
+  mkdir(directory.c_str(), 0755);
+  std::string name = handle;
+  for (auto &c : name) {
+    if (!isalnum((unsigned char)c))
+      c = '_';
+  }
+  return directory + "/" + name + ".ignore";
+}
+
+ignore_ptr ignore_list::compile(void) const {
+  return std::make_shared<const ignore_matcher>(list);
+}
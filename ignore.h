@@ -0,0 +1,115 @@
+#ifndef IGNORE_H
+#define IGNORE_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// what to ignore
+enum ignore_type : unsigned {
+  IGNORE_PRIVMSG = 1,
+  IGNORE_NOTICE = 2,
+  IGNORE_CTCP = 4,
+  IGNORE_ACTION = 8,
+  IGNORE_JOINS = 16, // JOIN / PART / KICK / QUIT / NICK
+  IGNORE_ALL = 31,
+};
+
+unsigned ignore_types(const std::string &names);
+std::string ignore_names(unsigned types);
+
+/**
+ * @brief message type, for matching against the ignore rules.
+ *
+ * @param cmd
+ * @param msg last parameter
+ * @return unsigned ignore_type, or 0
+ */
+unsigned ignore_kind(const std::string &cmd, const std::string &msg);
+
+struct ignore_rule {
+  std::string mask; // nick!user@host, wildcards * and ?
+  unsigned types;
+  std::string channel; // empty for all
+};
+
+/**
+ * @brief Compiled glob
+ *
+ * The pattern is split into literal runs between the *'s, so matching is a
+ * left to right scan with no backtracking past the last *.
+ */
+class glob {
+public:
+  glob(const std::string &pattern);
+  bool match(const std::string &text) const;
+
+private:
+  bool match_at(const std::string &segment, const std::string &text,
+                size_t pos) const;
+  std::vector<std::string> segments;
+  bool anchor_start;
+  bool anchor_end;
+};
+
+/**
+ * @brief Compiled ignore rules.
+ *
+ * Immutable once built.  Masks that are an exact nick (nick!*@*), an exact
+ * host (*!*@host) or an exact nick!user@host go into hashed lookups, the rest
+ * are compiled globs.
+ */
+class ignore_matcher {
+public:
+  ignore_matcher(const std::vector<ignore_rule> &rules);
+
+  bool empty(void) const { return count == 0; }
+  unsigned match(const std::string &prefix, const std::string &channel) const;
+
+private:
+  struct entry {
+    unsigned types;
+    std::string channel;
+  };
+  typedef std::unordered_map<std::string, std::vector<entry>> entry_map;
+
+  static unsigned types_for(const std::vector<entry> &entries,
+                            const std::string &channel);
+
+  int count;
+  entry_map nicks;
+  entry_map hosts;
+  entry_map exact;
+  std::vector<std::pair<glob, entry>> globs;
+};
+
+typedef std::shared_ptr<const ignore_matcher> ignore_ptr;
+
+/**
+ * @brief The user's ignore rules, saved per user.
+ */
+class ignore_list {
+public:
+  void load(const std::string &filename);
+  bool save(void);
+
+  std::string add(const std::string &mask, unsigned types,
+                  const std::string &channel);
+  bool remove(const std::string &mask);
+
+  const std::vector<ignore_rule> &rules(void) const { return list; }
+  ignore_ptr compile(void) const;
+
+private:
+  std::string filename;
+  std::vector<ignore_rule> list;
+};
+
+std::string normalize_mask(const std::string &mask);
+std::string ignore_filename(const std::string &directory,
+                            const std::string &handle);
+
+extern ignore_list user_ignores;
+
+#endif
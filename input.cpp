@@ -1,14 +1,18 @@
 #include "input.h"
+#include "commands.h"
+#include "config.h"
+#include "encoding.h"
+#include "focus.h"
+#include "networks.h"
+#include "paste.h"
 #include "render.h"
 
-bool allow_part = false;
-bool allow_join = false;
 bool has_quit = false;
 
-int ms_input_delay = 250;
 std::string input;
 std::string prompt; // mostly for length to erase/restore properly
-int max_input = 220;
+// shown instead of the input line while there's no prompt (unread count)
+static std::string status;
 int input_scroll = 0;
 door::ANSIColor prompt_color{door::COLOR::YELLOW, door::COLOR::BLUE,
                              door::ATTR::BOLD};
@@ -23,10 +27,192 @@ void erase(door::Door &d, int count)
   }
 }
 
+/*
+ * Input line layouts:
+ *
+ * LAYOUT_ERASE  the input line follows the output.  It's erased (\x08 \x08
+ *               per character) before output, and drawn again after.
+ * LAYOUT_CURSOR the same, but erased with \r and ESC[K, and changes to it
+ *               (scrolling, completion) only redraw what changed.
+ * LAYOUT_REGION the output scrolls in rows 1 to height - 1 (DECSTBM), the
+ *               input line stays on the bottom row.  Output just moves the
+ *               cursor up, nothing is erased or redrawn.
+ *
+ * For CURSOR and REGION, shown_row is what the input row has on it.  When
+ * there's no prompt (REGION), the cursor waits at the output position.
+ */
+enum layout_mode
+{
+  LAYOUT_ERASE,
+  LAYOUT_CURSOR,
+  LAYOUT_REGION
+};
+
+static layout_mode layout = LAYOUT_ERASE;
+static std::string shown_row;
+static int output_row; // last row of the scroll region
+static int input_row;
+
+/**
+ * @brief pick the input line layout
+ *
+ * region needs a known screen height, without it we use cursor.
+ *
+ * @param d
+ * @param setting erase, cursor or region
+ */
+void input_layout(door::Door &d, const std::string &setting)
+{
+  layout = LAYOUT_ERASE;
+  if (setting == "cursor")
+    layout = LAYOUT_CURSOR;
+  if (setting == "region")
+    layout = (d.height >= 5) ? LAYOUT_REGION : LAYOUT_CURSOR;
+
+  if (layout == LAYOUT_REGION)
+  {
+    input_row = d.height;
+    output_row = d.height - 1;
+    d << "\x1b[1;" << output_row << "r"
+      << "\x1b[" << input_row << ";1H\x1b[K"
+      << "\x1b[" << output_row << ";1H";
+  }
+  shown_row.clear();
+}
+
+/**
+ * @brief give the terminal its whole screen back
+ */
+void input_layout_end(door::Door &d)
+{
+  if (layout == LAYOUT_REGION)
+    d << "\x1b[r\x1b[" << input_row << ";1H";
+  layout = LAYOUT_ERASE;
+}
+
+/**
+ * @brief the input row as it should be (no colors)
+ */
+static std::string input_view(void)
+{
+  if (prompt.empty())
+    return status;
+  if (input_scroll == 0)
+    return prompt + " " + input;
+  return prompt + " ..." + input.substr(input_scroll);
+}
+
+/**
+ * @brief redraw the part of the input row that changed (CURSOR, REGION)
+ *
+ * @param d
+ */
+static void draw_input(door::Door &d)
+{
+  std::string want = input_view();
+  size_t same = 0;
+  while ((same < shown_row.size()) and (same < want.size()) and
+         (shown_row[same] == want[same]))
+    ++same;
+  // the prompt (or status) has its own color, draw it all
+  size_t head = prompt.empty() ? want.size() : prompt.size();
+  if (same <= head)
+    same = 0;
+
+  if ((same == want.size()) and (same == shown_row.size()))
+  {
+    // nothing changed, put the cursor back
+    if (prompt.empty())
+      return;
+    if (layout == LAYOUT_REGION)
+      d << "\x1b[" << input_row << ";" << want.size() + 1 << "H";
+    d << input_color;
+    return;
+  }
+
+  if (layout == LAYOUT_REGION)
+    d << "\x1b[" << input_row << ";" << same + 1 << "H";
+  else
+  {
+    d << "\r";
+    if (same > 0)
+      d << "\x1b[" << same << "C";
+  }
+
+  if ((same == 0) and (!want.empty()))
+    d << prompt_color << want.substr(0, head) << input_color
+      << want.substr(head);
+  else
+    d << input_color << want.substr(same);
+  if (want.size() < shown_row.size())
+    d << "\x1b[K";
+  shown_row = want;
+
+  // no input line, the cursor waits at the output
+  if ((layout == LAYOUT_REGION) and (prompt.empty()))
+    d << door::reset << "\x1b[" << output_row << ";1H";
+}
+
+/**
+ * @brief the input line is about to change (scroll, completion)
+ *
+ * @param d
+ */
+static void mark_input(door::Door &d)
+{
+  if (layout == LAYOUT_ERASE)
+    clear_input(d);
+  else
+    shown_row = input_view();
+}
+
+/**
+ * @brief the input line changed, show it
+ *
+ * @param d
+ */
+static void update_input(door::Door &d)
+{
+  if (layout == LAYOUT_ERASE)
+    restore_input(d);
+  else
+    draw_input(d);
+}
+
+/**
+ * @brief make room for output
+ *
+ * @param d
+ */
 void clear_input(door::Door &d)
 {
   if (prompt.empty())
+  {
+    if ((status.empty()) or (layout == LAYOUT_REGION))
+      return;
+    if (layout == LAYOUT_CURSOR)
+    {
+      d << door::reset << "\r\x1b[K";
+      shown_row.clear();
+    }
+    else
+      erase(d, status.size());
+    return;
+  }
+
+  if (layout == LAYOUT_REGION)
+  {
+    shown_row = input_view();
+    d << door::reset << "\x1b[" << output_row << ";1H";
+    return;
+  }
+
+  if (layout == LAYOUT_CURSOR)
+  {
+    d << door::reset << "\r\x1b[K";
+    shown_row.clear();
     return;
+  }
 
   if (input_scroll == 0)
     erase(d, input.size());
@@ -35,10 +221,25 @@ void clear_input(door::Door &d)
   erase(d, prompt.size() + 1);
 }
 
+/**
+ * @brief show the input line again (after output, or a change to it)
+ *
+ * @param d
+ */
 void restore_input(door::Door &d)
 {
+  if (layout != LAYOUT_ERASE)
+  {
+    draw_input(d);
+    return;
+  }
+
   if (prompt.empty())
+  {
+    if (!status.empty())
+      d << prompt_color << status << input_color;
     return;
+  }
 
   d << prompt_color << prompt << input_color << " ";
   if (input_scroll == 0)
@@ -47,254 +248,34 @@ void restore_input(door::Door &d)
     d << "..." << input.substr(input_scroll);
 }
 
-/*
-commands:
-
-/h /help /?
-/t /talk /talkto [TARGET]
-/msg [TO] [message]
-/me [message]
-/quit [message, maybe]
-/join [TARGET]
-/part [TARGET]
-
-future:
-/list    ?
-/version ?
-*/
-
 void parse_input(door::Door &door, ircClient &irc)
 {
   // yes, we have something
   std::time_t now_t;
   time(&now_t);
 
+  // IRC is UTF-8
+  input = from_terminal(input);
+
   if (input[0] == '/')
   {
     // command given
-    std::vector<std::string> cmd = split_limit(input, 3);
-
-    if (cmd[0] == "/motd")
-    {
-      irc.write("MOTD");
-    }
-
-    if (cmd[0] == "/names")
-    {
-      std::string talk = irc.talkto();
-      if (talk[0] == '#')
-      {
-        // or we could pull this from /info & talk.
-        irc.write("NAMES " + talk);
-      } // handle this input error
-    }
-
-    if (cmd[0] == "/quit")
-    {
-      irc.write("QUIT");
-    }
-
-    if (cmd[0] == "/talkto")
-    {
-      if (cmd.size() == 2)
-      {
-        irc.talkto(cmd[1]);
-        door << "[talkto = " << cmd[1] << "]" << door::nl;
-      }
-      else
-      {
-        door << "/talkto nick|<#channel>" << door::nl;
-      }
-    }
-
-    if (cmd[0] == "/join")
-    {
-      if (allow_join)
-      {
-        if (cmd.size() == 2)
-        {
-          std::string tmp = "JOIN " + cmd[1];
-          irc.write(tmp);
-        }
-        else
-        {
-          door << "/join #channel" << door::nl;
-        }
-      }
-      else
-      {
-        door << "SysOp has join disabled." << door::nl;
-      }
-    }
-
-    if (cmd[0] == "/part")
-    {
-      if (allow_part)
-      {
-        if (cmd.size() == 2)
-        {
-          std::string tmp = "PART " + cmd[1];
-          irc.write(tmp);
-        }
-        else
-        {
-          door << "/part #channel" << door::nl;
-        }
-      }
-      else
-      {
-        door << "SysOp has part disabled." << door::nl;
-      }
-    }
-
-    // TODO: feed this and /me to render so DRY/one place to render
-    if (cmd[0] == "/msg")
-    {
-      if (cmd.size() == 3)
-      {
-        std::string tmp = "PRIVMSG " + cmd[1] + " :" + cmd[2];
-        irc.write(tmp);
-        // build msg for render
-        tmp = ":" + irc.nick + "!" + " " + tmp;
-        message_stamp msg;
-        msg.buffer = irc_split(tmp);
-        render(msg, door, irc);
-      }
-      else
-      {
-        door << "/msg nick|#channel message to send" << door::nl;
-      }
-      /*
-      stamp(now_t, door);
-      if (cmd[1][0] == '#') {
-        door << irc.nick << "/" << cmd[1] << " " << cmd[2] << door::nl;
-      } else {
-        door << cmd[1] << " " << cmd[2] << door::nl;
-      }
-      */
-    }
-
-    if (cmd[0] == "/notice")
-    {
-      if (cmd.size() == 3)
-      {
-        std::string tmp = "NOTICE " + cmd[1] + " :" + cmd[2];
-        irc.write(tmp);
-        // build msg for render
-        tmp = ":" + irc.nick + "!" + " " + tmp;
-        message_stamp msg;
-        msg.buffer = irc_split(tmp);
-        render(msg, door, irc);
-      }
-      else
-      {
-        door << "/notice nick|#channel notice message to send" << door::nl;
-      }
-    }
-
-    if (cmd[0] == "/me")
-    {
-      cmd = split_limit(input, 2);
-      if (cmd.size() == 2)
-      {
-        std::string tmp =
-            "PRIVMSG " + irc.talkto() + " :\x01" + "ACTION " + cmd[1] + "\x01";
-        irc.write(tmp);
-        // build msg for render
-        tmp = ":" + irc.nick + "!" + " ACTION " + irc.talkto() + " :" + cmd[1];
-        message_stamp msg;
-        msg.buffer = irc_split(tmp);
-        render(msg, door, irc);
-      }
-      else
-      {
-        door << "/me <action to perform>" << door::nl;
-      }
-      /*
-      stamp(now_t, door);
-      door << "* " << irc.nick << " " << cmd[1] << door::nl;
-      */
-    }
-
-    if (cmd[0] == "/nick")
-    {
-      if (cmd.size() == 2)
-      {
-        std::string tmp = "NICK " + cmd[1];
-        irc.write(tmp);
-      }
-      else
-      {
-        door << "/nick new_nick" << door::nl;
-      }
-    }
-
-    if (cmd[0] == "/help")
-    {
-      door << "IRC Commands :" << door::nl;
-      door << "/help /motd /quit /nick" << door::nl;
-      door << "/me ACTION" << door::nl;
-      door << "/msg TARGET Message" << door::nl;
-
-      if (allow_part)
-      {
-        door << "/join #CHANNEL" << door::nl;
-        door << "/part #CHANNEL" << door::nl;
-      }
-      door << "[ESC] aborts input" << door::nl;
-    }
-
-#ifdef DEVELOPER_CODE
-
-    if (cmd[0] == "/flood")
-    {
-      std::string target = irc.talkto();
-      std::string bugz = "bugz";
-      for (int x = 0; x < 20; ++x)
-      {
-        std::string message = "PRIVMSG " + target +
-                              " : CHANNEL FLOOD TESTING THIS IS MESSAGE " +
-                              std::to_string(x + 1) + " TEST TEST TEST";
-        irc.write_queue(target, message);
-        message = "PRIVMSG " + bugz + " : USER FLOOD TESTING THIS IS MESSAGE " +
-                  std::to_string(x + 1) + " TEST TEST TEST";
-        irc.write_queue(bugz, message);
-        message = "PRIVMSG apollo : USER FLOOD TESTING THIS IS MESSAGE " +
-                  std::to_string(x + 1) + " TEST TEST TEST";
-        irc.write_queue("apollo", message);
-      }
-    }
-
-    if (cmd[0] == "/info")
-    {
-      irc.channels_lock.lock();
-      for (auto c : irc.channels)
-      {
-        door << "CH " << c.first << " ";
-        for (auto s : c.second)
-        {
-          door << s << " ";
-        }
-        door << door::nl;
-      }
-      irc.channels_lock.unlock();
-    }
-#endif
+    run_command(door, irc, input);
   }
   else
   {
     std::string target = irc.talkto();
     std::string output = "PRIVMSG " + target + " :" + input;
+    irc.send_text("PRIVMSG", target, input);
     // I need to display something here to show we've said something (and
     // where we've said it)
     door::ANSIColor nick_color{door::COLOR::WHITE, door::COLOR::BLUE};
 
-    irc.write(output);
-
     // build message for render
     message_stamp msg;
     output = ":" + irc.nick + "!" + " " + output;
-    msg.buffer = irc_split(output);
+    msg.assign(irc_split(output));
+    msg.target = irc.talkto_atom();
     render(msg, door, irc);
     /*
     stamp(now_t, door);
@@ -316,70 +297,350 @@ void parse_input(door::Door &door, ircClient &irc)
   input_scroll = 0;
 }
 
-// can't do /motd it matches /me /msg
-// nick matches names.
+/**
+ * @brief send the pasted lines, with one line to show for them
+ *
+ * @param door input line must already be cleared
+ */
+static void send_pasted(door::Door &door)
+{
+  door::ANSIColor info{door::COLOR::CYAN};
+  ircClient &irc = paste.network();
+  std::string target = paste.talkto();
+  std::vector<std::string> lines;
+
+  for (auto const &line : paste.take())
+    lines.push_back(from_terminal(line));
+  irc.send_paste(target, lines);
+  door << info << "[pasted " << lines.size() << " lines to "
+       << irc.display_name(target) << "]" << door::reset << door::nl;
+}
 
-const char *hot_keys[] = {"/join #", "/part #", "/talkto ", "/help", "/quit "};
+/**
+ * @brief once the keys stop, send (or ask about) what was pasted
+ *
+ * A "paste" of one line was just fast typing, it's handled like any other
+ * line (so commands work).  Whatever was typed after the paste stays on the
+ * input line.
+ *
+ * @param door
+ */
+void paste_check(door::Door &door)
+{
+  if ((!paste.pending()) or (paste.asking()) or (!paste.idle()))
+    return;
 
-bool check_for_input(door::Door &door, ircClient &irc)
+  std::string typed = input;
+  std::string shown = prompt;
+  int scroll = input_scroll;
+  clear_input(door);
+
+  if (paste.size() == 1)
+  {
+    ircClient &irc = paste.network();
+    input = paste.take()[0];
+    prompt.clear();
+    parse_input(door, irc);
+    input = typed;
+    prompt = shown;
+    input_scroll = scroll;
+  }
+  else
+  {
+    int confirm = current_config()->paste_confirm;
+    if ((confirm > 0) and ((int)paste.size() > confirm))
+    {
+      door::ANSIColor info{door::COLOR::CYAN, door::ATTR::BOLD};
+      door << info << "Send " << paste.size() << " pasted lines to "
+           << paste.network().display_name(paste.talkto()) << "? (y/n)"
+           << door::reset << door::nl;
+      paste.ask();
+    }
+    else
+      send_pasted(door);
+  }
+  restore_input(door);
+}
+
+/**
+ * @brief lag, for the prompt
+ *
+ * Only shown when it's high enough to notice.
+ *
+ * @param irc
+ * @return std::string
+ */
+static std::string lag_text(ircClient &irc)
+{
+  int lag = irc.lag_ms;
+  if (lag < 500)
+    return std::string();
+  if (lag < 1000)
+    return " lag " + std::to_string(lag) + "ms";
+  return " lag " + std::to_string(lag / 1000) + "." +
+         std::to_string((lag % 1000) / 100) + "s";
+}
+
+/**
+ * @brief unread messages focused mode is holding, for the prompt
+ *
+ * @return std::string
+ */
+static std::string unread_text(void)
+{
+  int unread = focus.unread();
+  if (unread == 0)
+    return std::string();
+  return " +" + std::to_string(unread);
+}
+
+static std::string build_prompt(ircClient &irc)
+{
+  return "[" + irc.display_name(irc.talkto()) + unread_text() +
+         lag_text(irc) + "]";
+}
+
+/**
+ * @brief focused mode's unread count changed, show it
+ *
+ * The prompt has the count.  With nothing typed there's no prompt, so the
+ * count is shown where it would be (the status), until a key is pressed.
+ *
+ * @param door
+ */
+void unread_changed(door::Door &door)
+{
+  ircClient &irc = networks.active();
+  mark_input(door);
+  int unread = focus.unread();
+  status = unread ? "[+" + std::to_string(unread) + " unread, Ctrl-N]"
+                  : std::string();
+  if (!prompt.empty())
+    prompt = build_prompt(irc);
+  update_input(door);
+}
+
+/**
+ * @brief Ctrl-N, talkto the next channel with unread messages
+ *
+ * @param door
+ */
+static void next_unread(door::Door &door)
+{
+  ircClient *net;
+  std::string channel;
+  if (!focus.next(net, channel))
+  {
+    door << (char)7;
+    return;
+  }
+
+  std::string target = net->display_name(channel);
+  networks.select(target).talkto(target);
+  door << "[talkto = " << net->display_name(channel) << "]" << door::nl;
+}
+
+// tab completion cycle
+std::vector<std::string> completions;
+int completion_pos = 0;
+size_t completion_start = 0;
+
+/**
+ * @brief Tab completion
+ *
+ * Completes the word before the cursor:  commands (at the start of the line),
+ * #channels, or nicks in the talkto channel.  Pressing Tab again cycles
+ * through the matches.
+ *
+ * @param door
+ * @param irc
+ */
+void complete_input(door::Door &door, ircClient &irc)
+{
+  bool at_start;
+
+  if (completions.empty())
+  {
+    size_t space = input.rfind(' ');
+    completion_start = (space == std::string::npos) ? 0 : space + 1;
+    std::string word = input.substr(completion_start);
+
+    if (word.empty())
+    {
+      door << (char)7;
+      return;
+    }
+
+    if ((completion_start == 0) and (word[0] == '/'))
+    {
+      completions = complete_words(command_names(), word);
+    }
+    else if (word[0] == '#')
+    {
+      std::vector<std::string> names;
+      snapshot_ptr snapshot = irc.channels_snapshot();
+      for (auto const &ch : snapshot->channels)
+        names.push_back(ch.first);
+      completions = complete_words(names, word);
+    }
+    else
+    {
+      completions = irc.complete_nick(irc.talkto(), word);
+    }
+
+    if (completions.empty())
+    {
+      door << (char)7;
+      return;
+    }
+    completion_pos = 0;
+  }
+  else
+  {
+    ++completion_pos;
+    if (completion_pos >= (int)completions.size())
+      completion_pos = 0;
+  }
+
+  at_start = (completion_start == 0);
+  std::string word = completions[completion_pos];
+  if (at_start and (word[0] != '/') and (word[0] != '#'))
+    word += ":";
+
+  std::string completed = input.substr(0, completion_start) + word + " ";
+  if ((int)completed.size() > current_config()->max_input)
+  {
+    door << (char)7;
+    return;
+  }
+
+  mark_input(door);
+  input = completed;
+
+  // scroll, if we need to.
+  int prompt_size = prompt.size() + 1;
+  if ((int)input.size() + prompt_size + 3 >= door.width)
+    input_scroll = input.size() - door.width / 3;
+  else
+    input_scroll = 0;
+  update_input(door);
+}
+
+/**
+ * @brief a key that goes on the input line
+ *
+ * isprint() is ASCII only (in the C locale).  A CP437 terminal sends its
+ * glyphs as 0x80-0xff, and from_terminal() turns those into UTF-8.
+ *
+ * @param c
+ * @return true
+ */
+static bool is_input_key(int c)
+{
+  if (door_encoding == ENCODING_CP437)
+    return (c >= 0x20) and (c != 0x7f) and (c < 0x100);
+  return isprint(c);
+}
+
+/**
+ * @brief Handle a key (or door sleep_key result)
+ *
+ * @param door
+ * @param irc
+ * @param c key, or -1 timeout, -2 hangup, -3 out of time
+ * @return true input line was sent
+ */
+bool process_key(door::Door &door, ircClient &irc, int c)
 {
-  int c;
   int width = door.width;
   int third = width / 3;
 
+  // answer to "Send N pasted lines?"
+  if ((c > 0) and (paste.asking()))
+  {
+    clear_input(door);
+    if ((c == 'y') or (c == 'Y'))
+      send_pasted(door);
+    else
+    {
+      paste.take();
+      door << "[paste not sent]" << door::nl;
+    }
+    restore_input(door);
+    return false;
+  }
+  bool pasting = false;
+  if (c > 0)
+  {
+    paste.key();
+    pasting = paste.pasting(door);
+    // a pasted Tab is text, not completion
+    if ((pasting) and (c == 0x09))
+      c = ' ';
+  }
+
+  // /list pager takes the keys while the input line is empty
+  if ((c > 0) and (input.empty()) and (channel_pager.active()))
+  {
+    if (channel_pager.key(door, c))
+      return false;
+  }
+
   // return true when we have input and is "valid" // ready
   if (prompt.empty())
   {
     // ok, nothing has been displayed at this time.
-    if (door.haskey())
+    if (c < 0)
     {
-      // something to do.
-      c = door.sleep_key(1);
-      if (c < 0)
+      // handle timeout/hangup/out of time
+      if (c < -1)
       {
-        // handle timeout/hangup/out of time
-        if (c < -1)
+        if (!has_quit)
         {
-          if (!has_quit)
-          {
-            std::string quit = "QUIT :";
-            if (c == -2)
-              quit += "BBS User Dropped Connection";
-            if (c == -3)
-              quit += "BBS User Out of time";
-            irc.write(quit);
-            has_quit = true;
-          }
+          std::string quit = "QUIT :";
+          if (c == -2)
+            quit += "BBS User Dropped Connection";
+          if (c == -3)
+            quit += "BBS User Out of time";
+          networks.write_all(quit);
+          has_quit = true;
         }
-        return false;
       }
-      if (c > 0x1000)
-        return false;
-
-      // How to handle "early" typing, we we're still connecting...
-      // FAIL-WHALE (what if we part all channels?)
-      if (irc.registered)
-        // don't take any imput unless our talkto has been set.
-        if (isprint(c))
-        {
-          prompt = "[" + irc.talkto() + "]";
-          door << prompt_color << prompt << input_color << " ";
+      return false;
+    }
+    if (c > 0x1000)
+      return false;
 
-          door << (char)c;
-          input.append(1, c);
-        }
+    if (c == 0x0e)
+    {
+      // Ctrl-N
+      clear_input(door); // the status
+      next_unread(door);
+      restore_input(door);
+      return false;
     }
+
+    // How to handle "early" typing, we we're still connecting...
+    // FAIL-WHALE (what if we part all channels?)
+    if (irc.registered)
+      // don't take any imput unless our talkto has been set.
+      if (is_input_key(c))
+      {
+        clear_input(door); // the status
+        prompt = build_prompt(irc);
+        input.append(1, c);
+        restore_input(door);
+      }
     return false;
   }
   else
   {
     // continue on with what we have displayed.
-    c = door.sleep_ms_key(ms_input_delay);
     if (c < -1)
     {
       if (!has_quit)
       {
-        irc.write("QUIT");
+        networks.write_all("QUIT");
         has_quit = true;
       }
     }
@@ -394,11 +655,20 @@ bool check_for_input(door::Door &door, ircClient &irc)
       */
       if (c > 0x1000)
         return false;
-      if (isprint(c))
+
+      if (c == 0x09)
+      {
+        complete_input(door, irc);
+        return false;
+      }
+      // any other key ends the completion cycle
+      completions.clear();
+
+      if (is_input_key(c))
       {
         // string length check / scroll support?
 
-        if ((int)input.size() == max_input)
+        if ((int)input.size() >= current_config()->max_input)
         {
           door << (char)7;
           return false;
@@ -417,37 +687,23 @@ bool check_for_input(door::Door &door, ircClient &irc)
         if (pos + prompt_size + 3 == width)
         {
           // Ok, scroll!
-          clear_input(door);
+          mark_input(door);
           input_scroll = input.size() - third;
-          restore_input(door);
+          update_input(door);
         }
-        // hot-keys
-        if (input[0] == '/')
+        // hot-keys (not in pasted text)
+        if ((input[0] == '/') and (!pasting))
         {
           if (input.size() == 2)
           {
             char c = std::tolower(input[1]);
+            const char *hk = hot_key_expand(c);
 
-            if (!allow_part)
+            if (hk != nullptr)
             {
-              if (c == 'p')
-                c = '!';
-            }
-            if (!allow_join)
-            {
-              if (c == 'j')
-                c = '!';
-            }
-
-            for (auto hk : hot_keys)
-            {
-              if (c == hk[1])
-              {
-                erase(door, input.size());
-                input = hk;
-                door << input;
-                break;
-              }
+              erase(door, input.size());
+              input = hk;
+              door << input;
             }
           }
         }
@@ -460,26 +716,22 @@ bool check_for_input(door::Door &door, ircClient &irc)
         input.clear();
         prompt.clear();
         input_scroll = 0;
+        restore_input(door);
         return false;
       }
 
       if ((c == 0x08) or (c == 0x7f))
       {
         // hot-keys
-        if (input[0] == '/')
+        if ((input[0] == '/') and (is_hot_key(input)))
         {
-          for (auto hk : hot_keys)
-          {
-            if (input == hk)
-            {
-              clear_input(door);
+          clear_input(door);
 
-              input.clear();
-              prompt.clear();
-              input_scroll = 0;
-              return false;
-            }
-          }
+          input.clear();
+          prompt.clear();
+          input_scroll = 0;
+          restore_input(door);
+          return false;
         }
         if (input.size() > 1)
         {
@@ -492,34 +744,69 @@ bool check_for_input(door::Door &door, ircClient &irc)
             if ((int)input.size() - third < input_scroll)
             {
               // scroll the other way
-              clear_input(door);
+              mark_input(door);
               input_scroll = (input.size() - 2 * third);
               if (input_scroll < 0)
                 input_scroll = 0;
-              restore_input(door);
+              update_input(door);
             }
           }
         }
         else
         {
           // erasing the last character
-          erase(door, 1);
+          clear_input(door);
           input.clear();
-          erase(door, prompt.size() + 1);
           prompt.clear();
+          restore_input(door);
           return false;
         }
       }
       if (c == 0x0d)
       {
+        if ((paste.pending()) or (paste.burst(door, input.size())))
+        {
+          // pasted, hold it until the keys stop
+          clear_input(door);
+          paste.add(irc, input);
+          prompt.clear();
+          input.clear();
+          input_scroll = 0;
+          restore_input(door);
+          return false;
+        }
         clear_input(door);
         prompt.clear();
         parse_input(door, irc);
         input.clear();
         input_scroll = 0;
+        restore_input(door);
         return true;
       }
     }
     return false;
   }
 }
+
+bool check_for_input(door::Door &door, ircClient &irc)
+{
+  int c;
+
+  paste_check(door);
+  if (prompt.empty())
+  {
+    // nothing displayed, don't wait on input.
+    if (!door.haskey())
+      return false;
+    c = door.sleep_key(1);
+  }
+  else
+  {
+    int delay = current_config()->input_delay;
+    // don't sit on a paste
+    if ((paste.pending()) and (current_config()->paste_ms < delay))
+      delay = current_config()->paste_ms;
+    c = door.sleep_ms_key(delay);
+  }
+  return process_key(door, irc, c);
+}
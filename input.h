@@ -4,14 +4,17 @@
 #include "door.h"
 #include "irc.h"
 
-extern bool allow_part;
-extern bool allow_join;
-extern int ms_input_delay;
+extern bool has_quit;
 
+void input_layout(door::Door &d, const std::string &setting);
+void input_layout_end(door::Door &d);
 void clear_input(door::Door &d);
 void restore_input(door::Door &d);
 void parse_input(door::Door &door, ircClient &irc);
 
+bool process_key(door::Door &door, ircClient &irc, int c);
 bool check_for_input(door::Door &d, ircClient &irc);
+void paste_check(door::Door &door);
+void unread_changed(door::Door &door);
 
 #endif
\ No newline at end of file
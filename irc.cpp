@@ -1,7 +1,11 @@
 #include "irc.h"
+#include "transcript.h"
 
 #include <boost/algorithm/string.hpp>
+#include <climits>
 #include <iostream>
+#include <sstream>
+#include <unordered_set>
 
 void string_toupper(std::string &str) {
   std::transform(str.begin(), str.end(), str.begin(), ::toupper);
@@ -35,7 +39,7 @@ void remove_channel_modes(std::string &nick) {
  * @param max
  * @return std::vector<std::string>
  */
-std::vector<std::string> split_limit(std::string &text, int max) {
+std::vector<std::string> split_limit(const std::string &text, int max) {
   std::vector<std::string> ret;
   int t = 0;
   boost::split(ret, text, [&t, max](char c) {
@@ -78,6 +82,80 @@ std::vector<std::string> irc_split(std::string &text) {
   return results;
 }
 
+/**
+ * @brief split text into pieces of at most max_bytes
+ *
+ * Breaks at a space when there's one in the second half of the piece,
+ * otherwise at max_bytes (backed up so a UTF-8 character isn't cut in two).
+ *
+ * @param text
+ * @param max_bytes
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> split_text(const std::string &text,
+                                    size_t max_bytes) {
+  std::vector<std::string> lines;
+  size_t pos = 0;
+
+  if (max_bytes < 8)
+    max_bytes = 8;
+
+  while (text.size() - pos > max_bytes) {
+    size_t cut = text.rfind(' ', pos + max_bytes);
+    if ((cut != std::string::npos) and (cut > pos + max_bytes / 2)) {
+      lines.push_back(text.substr(pos, cut - pos));
+      pos = cut + 1;
+      continue;
+    }
+
+    cut = pos + max_bytes;
+    // don't split a UTF-8 sequence (continuation bytes are 10xxxxxx)
+    while ((cut > pos + 1) and (((unsigned char)text[cut] & 0xc0) == 0x80))
+      --cut;
+    lines.push_back(text.substr(pos, cut - pos));
+    pos = cut;
+  }
+
+  if (pos < text.size())
+    lines.push_back(text.substr(pos));
+  return lines;
+}
+
+/**
+ * @brief irc split, into an existing vector
+ *
+ * Same as irc_split(text), but the strings already in results are reused, so
+ * a long lived results vector doesn't allocate for the common messages.
+ *
+ * @param text
+ * @param results
+ */
+void irc_split(const std::string &text, std::vector<std::string> &results) {
+  size_t msgpos = text.find(" :");
+  size_t end = (msgpos == std::string::npos) ? text.size() : msgpos;
+  size_t count = 0;
+  size_t pos = 0;
+
+  while (true) {
+    size_t space = text.find(' ', pos);
+    if ((space == std::string::npos) or (space > end))
+      space = end;
+    if (results.size() <= count)
+      results.emplace_back();
+    results[count++].assign(text, pos, space - pos);
+    if (space >= end)
+      break;
+    pos = space + 1;
+  }
+
+  if ((msgpos != std::string::npos) and (msgpos + 2 < text.size())) {
+    if (results.size() <= count)
+      results.emplace_back();
+    results[count++].assign(text, msgpos + 2, std::string::npos);
+  }
+  results.resize(count);
+}
+
 /**
  * @brief parse_nick
  *
@@ -86,7 +164,7 @@ std::vector<std::string> irc_split(std::string &text) {
  * @param name
  * @return std::string
  */
-std::string parse_nick(std::string &name) {
+std::string parse_nick(const std::string &name) {
   std::string to = name;
   if (to[0] == ':')
     to.erase(0, 1);
@@ -97,6 +175,26 @@ std::string parse_nick(std::string &name) {
   return to;
 }
 
+/**
+ * @brief intern a target name
+ *
+ * This locks, so it isn't for the per-message path.  The io_context thread
+ * uses ircClient::atom (which caches) instead.
+ *
+ * @param name
+ * @return target_atom
+ */
+target_atom intern_target(const std::string &name) {
+  static boost::signals2::mutex pool_lock;
+  // node based, so pointers to the strings stay valid.
+  static std::unordered_set<std::string> pool;
+
+  pool_lock.lock();
+  target_atom atom = &*pool.insert(name).first;
+  pool_lock.unlock();
+  return atom;
+}
+
 // namespace io = boost::asio;
 // namespace ip = io::ip;
 // using tcp = boost::asio::ip; // ip::tcp;
@@ -110,19 +208,33 @@ typedef std::function<void(std::string &)> receiveFunction;
 
 #ifdef SENDQ
 ircClient::ircClient(boost::asio::io_context &io_context)
-    : resolver{io_context}, ssl_context{boost::asio::ssl::context::tls},
-      socket{io_context, ssl_context},
-      sendq_timer{io_context}, context{io_context} {
+    : lag_timer{io_context}, sendq_timer{io_context}, context{io_context} {
 #else
 ircClient::ircClient(boost::asio::io_context &io_context)
-    : resolver{io_context}, ssl_context{boost::asio::ssl::context::tls},
-      socket{io_context, ssl_context}, context{io_context} {
+    : lag_timer{io_context}, context{io_context} {
 #endif
   registered = false;
   nick_retry = 1;
   shutdown = false;
   logging = false;
+  log_level = 1;
+  max_queue = 500;
+  dropped_messages = 0;
   channels_updated = false;
+  activity = 0;
+  snapshot = std::make_shared<const channel_snapshot>();
+  ignores = std::make_shared<const ignore_matcher>(std::vector<ignore_rule>{});
+  highlights =
+      std::make_shared<const keyword_matcher>(std::vector<std::string>{});
+  list_ready = false;
+  ping_outstanding = false;
+  missed_pings = 0;
+  ping_interval = 60;
+  ping_missed = 3;
+  lag_ms = 0;
+  for (auto &count : lag_histogram)
+    count = 0;
+  _talkto = intern_target("");
   version = "Bugz IRC thing V0.1";
 #ifdef SENDQ
   sendq_current = 0;
@@ -132,6 +244,20 @@ ircClient::ircClient(boost::asio::io_context &io_context)
 #endif
 }
 
+/**
+ * @brief open the debug log, if there is one and log_level wants it
+ *
+ * Called from begin(), and tune() for a live reload (io_context thread):
+ * raising log_level from 0 opens it, dropping it to 0 stops logging.
+ */
+void ircClient::open_log(void) {
+  if ((!debug_file.is_open()) and (!debug_output.empty()) and
+      (log_level > 0))
+    debug_file.open(debug_output.c_str(),
+                    std::ofstream::out | std::ofstream::app);
+  logging = (debug_file.is_open()) and (log_level > 0);
+}
+
 std::ofstream &ircClient::log(void) {
   std::time_t t = std::time(nullptr);
   std::tm tm = *std::localtime(&t);
@@ -139,15 +265,213 @@ std::ofstream &ircClient::log(void) {
   return debug_file;
 }
 
+/**
+ * @brief Use these ignore rules
+ *
+ * Safe from any thread, the io_context thread picks them up.
+ *
+ * @param matcher
+ */
+void ircClient::ignore(ignore_ptr matcher) {
+  boost::asio::post(context, [this, matcher]() -> void { ignores = matcher; });
+}
+
+/**
+ * @brief Set the custom highlight words
+ *
+ * Safe from any thread.  Our nick (and the nick we asked for) are always
+ * highlighted.
+ *
+ * @param words space or comma separated
+ */
+void ircClient::highlight_words(const std::string &words) {
+  boost::asio::post(context, [this, words]() -> void {
+    highlight_custom = words;
+    build_highlights();
+  });
+}
+
+/**
+ * @brief Start a /list
+ *
+ * Safe from any thread.  The 322 replies are collected (and filtered) by
+ * chan_list, and never go through the message queue.  When the list ends,
+ * the results are published and list_ready is set.
+ *
+ * @param filter
+ */
+void ircClient::list(const list_filter &filter) {
+  boost::asio::post(context, [this, filter]() -> void {
+    if (chan_list.active()) {
+      message("/list is already running");
+      return;
+    }
+    chan_list.begin(filter);
+    std::string elist;
+    auto pos = isupport.find("ELIST");
+    if (pos != isupport.end())
+      elist = pos->second;
+    write("LIST" + filter.server_args(elist));
+  });
+}
+
+/**
+ * @brief rebuild the highlight matcher (io_context thread)
+ */
+void ircClient::build_highlights(void) {
+  std::vector<std::string> words = split_words(highlight_custom);
+  words.push_back(nick);
+  if (original_nick != nick)
+    words.push_back(original_nick);
+  highlights = std::make_shared<const keyword_matcher>(words);
+}
+
+/**
+ * @brief Update the tunables.
+ *
+ * Called at startup, and again when the configuration is reloaded.
+ *
+ * @param sendq_ms delay between sendq lines
+ * @param max_queue maximum number of messages waiting to be rendered
+ * @param log_level 0 none, 1 traffic, 2 parser details
+ */
+void ircClient::tune(int sendq_ms, int max_queue, int log_level) {
+#ifdef SENDQ
+  this->sendq_ms = sendq_ms;
+#endif
+  this->max_queue = max_queue;
+  this->log_level = log_level;
+  open_log();
+}
+
+const int ircClient::lag_buckets[LAG_BUCKETS] = {50,   100,  250,  500,
+                                                  1000, 2000, 5000, INT_MAX};
+
+/**
+ * @brief Lag meter / watchdog settings
+ *
+ * @param interval_seconds between our PINGs, 0 turns them off
+ * @param missed unanswered PINGs before the link is dead
+ */
+void ircClient::lag_check(int interval_seconds, int missed) {
+  ping_interval = interval_seconds;
+  ping_missed = missed;
+}
+
+void ircClient::start_lag_timer(void) {
+  int interval = ping_interval;
+  // when turned off, check back in case it gets turned on
+  lag_timer.expires_after(std::chrono::seconds(interval > 0 ? interval : 5));
+  lag_timer.async_wait(std::bind(&ircClient::on_lag_timer, this, _1));
+}
+
+static long long steady_us(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             irc_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief Send our PING, and watch for the ones that weren't answered.
+ *
+ * @param error
+ */
+void ircClient::on_lag_timer(error_code error) {
+  if ((error) or (shutdown))
+    return;
+
+  if (ping_interval > 0) {
+    if (ping_outstanding) {
+      ++missed_pings;
+      if (missed_pings >= ping_missed) {
+        dead_link();
+        return;
+      }
+    }
+    write("PING :LAG" + std::to_string(steady_us()));
+    ping_outstanding = true;
+  }
+  start_lag_timer();
+}
+
+/**
+ * @brief PONG for our PING
+ *
+ * @param token LAG + steady clock microseconds when it was sent
+ */
+void ircClient::lag_pong(const std::string &token) {
+  long long rtt = (steady_us() - std::atoll(token.c_str() + 3)) / 1000;
+  if (rtt < 0)
+    return;
+
+  ping_outstanding = false;
+  missed_pings = 0;
+  // 0 means not measured yet
+  lag_ms = (rtt == 0) ? 1 : (int)rtt;
+
+  for (int x = 0; x < LAG_BUCKETS; ++x) {
+    if (rtt < lag_buckets[x]) {
+      ++lag_histogram[x];
+      break;
+    }
+  }
+
+  if ((logging) and (log_level > 1))
+    log() << "Lag: " << rtt << " ms" << std::endl;
+}
+
+/**
+ * @brief The server stopped answering, the connection is dead.
+ *
+ * A half-open connection would never complete the SSL shutdown, so close
+ * the socket and shut down now.
+ */
+void ircClient::dead_link(void) {
+  std::string output = "No reply from the server, connection lost.";
+  message(output);
+  errors.push_back(output);
+  if (logging) {
+    log() << "Lag: " << missed_pings << " PINGs not answered, closing"
+          << std::endl;
+  }
+
+  link->close();
+  on_shutdown(error_code());
+}
+
+#ifdef SENDQ
+/**
+ * @brief delay between sendq lines
+ *
+ * When the server is lagging, slow down so we aren't adding to it.
+ *
+ * @return int ms
+ */
+int ircClient::sendq_delay(void) {
+  int delay = sendq_ms;
+  int lag = lag_ms;
+  if (lag > delay)
+    delay += (lag - delay) / 2;
+  if (delay > 5000)
+    delay = 5000;
+  return delay;
+}
+#endif
+
 void ircClient::begin(void) {
   original_nick = nick;
-  resolver.async_resolve(hostname, port,
-                         std::bind(&ircClient::on_resolve, this, _1, _2));
-  if (!debug_output.empty()) {
-    debug_file.open(debug_output.c_str(),
-                    std::ofstream::out | std::ofstream::app);
-    logging = true;
-  }
+  build_highlights();
+  if (backlog_lines > 0)
+    backlog.begin(backlog_dir);
+  ctcp.set_version(version);
+  open_log();
+  if (!link)
+    link = make_transport(context, transport, hostname, port);
+  link->connect(std::bind(&ircClient::on_connect, this, _1, _2));
+}
+
+void ircClient::use_transport(std::unique_ptr<irc_transport> transport) {
+  link = std::move(transport);
 }
 
 void ircClient::write(std::string output) {
@@ -155,7 +479,7 @@ void ircClient::write(std::string output) {
     log() << "<< " << output << std::endl;
   }
   error_code error;
-  socket.write_some(boost::asio::buffer(output + "\r\n"), error);
+  link->write(output + "\r\n", error);
   if (error) {
     if (logging) {
       log() << "Write: " << error.message() << std::endl;
@@ -167,13 +491,26 @@ void ircClient::write(std::string output) {
 /**
  * @brief Add to the sendq for async slow message sending.
  *
- * target is used (we cycle through sendq_targets) so no one person can clog up
- * the queue.
+ * Safe from any thread.  target is used (we cycle through sendq_targets) so
+ * no one person can clog up the queue.
  *
  * @param target
  * @param output
  */
 void ircClient::write_queue(std::string target, std::string output) {
+  boost::asio::post(context, [this, target, output]() -> void {
+    send_line(target, output);
+  });
+}
+
+/**
+ * @brief Add to the sendq (io_context thread)
+ *
+ * @param target
+ * @param output
+ */
+void ircClient::send_line(const std::string &target,
+                          const std::string &output) {
   // is target in sendq_targets
   bool found = false;
   for (auto &t : sendq_targets) {
@@ -193,7 +530,7 @@ void ircClient::write_queue(std::string target, std::string output) {
     // async send is not active -- start the timer event
     sendq_active = true;
     sendq_current = 0;
-    sendq_timer.expires_after(std::chrono::milliseconds(sendq_ms));
+    sendq_timer.expires_after(std::chrono::milliseconds(sendq_delay()));
     sendq_timer.async_wait(std::bind(&ircClient::on_sendq, this, _1));
   }
 }
@@ -208,8 +545,6 @@ void ircClient::write_queue(std::string target, std::string output) {
  * After 20 lines, increase the sendq_ms (maybe 2*sendq_ms?)  After 50, maybe
  * 3*sendq_ms.  We want to throttle ourselves and not have the ircd doing it.
  *
- * Currently, this is not thread-safe.  It's being used by code that isn't
- * running the io_context in another thread.
  * @param error
  */
 void ircClient::on_sendq(error_code error) {
@@ -244,7 +579,7 @@ void ircClient::on_sendq(error_code error) {
 
   if (!sendq_targets.empty()) {
     // more to do, let's do it again!
-    sendq_timer.expires_after(std::chrono::milliseconds(sendq_ms));
+    sendq_timer.expires_after(std::chrono::milliseconds(sendq_delay()));
     sendq_timer.async_wait(std::bind(&ircClient::on_sendq, this, _1));
   } else {
     // let write_queue know we aren't running anymore.
@@ -253,117 +588,408 @@ void ircClient::on_sendq(error_code error) {
 }
 #endif
 
+/**
+ * @brief bytes of text that fit in one line (io_context thread)
+ *
+ * The server sends our line on with :nick!user@host in front of it, and
+ * that has to fit in LINELEN (512 unless ISUPPORT says otherwise) too.
+ * Until we've seen our prefix (JOIN), assume a long user@host.
+ *
+ * @param overhead "PRIVMSG #target :" and friends
+ * @return size_t
+ */
+size_t ircClient::text_budget(size_t overhead) {
+  size_t linelen = 512;
+  auto pos = isupport.find("LINELEN");
+  if ((pos != isupport.end()) and (std::atoi(pos->second.c_str()) > 0))
+    linelen = std::atoi(pos->second.c_str());
+
+  size_t prefix;
+  if (self_prefix.empty())
+    prefix = 1 + nick.size() + 1 + 11 + 1 + 63 + 1; // :nick!~user@host
+  else
+    prefix = self_prefix.size() + 1;
+
+  // CR LF
+  size_t used = prefix + overhead + 2;
+  if (used + 32 > linelen)
+    return 32;
+  return linelen - used;
+}
+
+/**
+ * @brief Send PRIVMSG / NOTICE / ACTION text
+ *
+ * Safe from any thread.  Text that doesn't fit in one line is split on word
+ * (or UTF-8) boundaries.  The first line goes out now, the rest are paced
+ * through the sendq.
+ *
+ * @param cmd PRIVMSG, NOTICE or ACTION
+ * @param target
+ * @param text
+ */
+void ircClient::send_text(const std::string &cmd, const std::string &target,
+                          const std::string &text) {
+  boost::asio::post(context, [this, cmd, target, text]() -> void {
+    queue_text(cmd, target, text, true);
+  });
+}
+
+/**
+ * @brief Send a pasted block of PRIVMSG lines
+ *
+ * Safe from any thread.  Only the first line can go out now, the rest are
+ * all paced through the sendq so a paste can't flood us off the server.
+ *
+ * @param target
+ * @param texts
+ */
+void ircClient::send_paste(const std::string &target,
+                           const std::vector<std::string> &texts) {
+  boost::asio::post(context, [this, target, texts]() -> void {
+    for (size_t x = 0; x < texts.size(); ++x)
+      queue_text("PRIVMSG", target, texts[x], x == 0);
+  });
+}
+
+/**
+ * @brief Split, log and send text (io_context thread)
+ *
+ * @param cmd PRIVMSG, NOTICE or ACTION
+ * @param target
+ * @param text
+ * @param now the first line can skip the sendq (if nothing is waiting)
+ */
+void ircClient::queue_text(const std::string &cmd, const std::string &target,
+                           const std::string &text, bool now) {
+  std::string head;
+  std::string tail;
+
+  if (cmd == "ACTION") {
+    head = "PRIVMSG " + target + " :\x01" + "ACTION ";
+    tail = "\x01";
+  } else {
+    head = cmd + " " + target + " :";
+  }
+
+  std::vector<std::string> lines =
+      split_text(text, text_budget(head.size() + tail.size()));
+
+  if (target[0] == '#') {
+    time_t stamp = irc_clock::wall();
+    std::string name = display_name(target);
+    transcripts.append(name, message_command(cmd), nick, text, stamp);
+    // the server doesn't echo our lines, so the other nodes see them
+    if (backlog.enabled())
+      backlog.append(name, stamp, message_command(cmd), nick, text);
+  }
+
+#ifdef SENDQ
+  // don't jump ahead of lines already waiting for this target
+  bool waiting = (!now) or (sendq.find(target) != sendq.end());
+  for (size_t x = 0; x < lines.size(); ++x) {
+    if ((x == 0) and (!waiting))
+      write(head + lines[x] + tail);
+    else
+      send_line(target, head + lines[x] + tail);
+  }
+#else
+  for (auto const &line : lines)
+    write(head + line + tail);
+#endif
+}
+
+/**
+ * @brief Add a channel PRIVMSG / ACTION / NOTICE to the shared backlog
+ *
+ * Only the node that owns the channel's ring writes it (see backlog_ring),
+ * so this is a no-op on the others.  parts can still be the raw PRIVMSG
+ * with a CTCP ACTION in it.
+ *
+ * @param parts
+ * @param stamp
+ */
+void ircClient::share_line(const std::vector<std::string> &parts,
+                           std::time_t stamp) {
+  if ((!backlog.enabled()) or (parts.size() < 4) or (parts[2][0] != '#'))
+    return;
+
+  message_cmd cmd = message_command(parts[1]);
+  if ((cmd != CMD_PRIVMSG) and (cmd != CMD_ACTION) and (cmd != CMD_NOTICE))
+    return;
+
+  const std::string &text = parts[parts.size() - 1];
+  if ((cmd == CMD_PRIVMSG) and (!text.empty()) and (text[0] == '\x01')) {
+    // only CTCP ACTION is a channel line
+    if (text.compare(0, 8, "\x01" "ACTION ") != 0)
+      return;
+    std::string action = text.substr(8);
+    if ((!action.empty()) and (action[action.size() - 1] == '\x01'))
+      action.erase(action.size() - 1);
+    backlog.append(display_name(parts[2]), stamp, CMD_ACTION,
+                   parse_nick(parts[0]), action);
+    return;
+  }
+  backlog.append(display_name(parts[2]), stamp, cmd, parse_nick(parts[0]),
+                 text);
+}
+
+/**
+ * @brief We joined channel, show what the other nodes saw before we got here
+ *
+ * @param channel
+ */
+void ircClient::replay_backlog(const std::string &channel) {
+  std::vector<backlog_line> lines =
+      backlog.join(display_name(channel), backlog_lines);
+  if (lines.empty())
+    return;
+
+  message("Recent lines in " + channel + ":");
+  target_atom channel_atom = atom(channel);
+  std::vector<std::string> parts(4);
+  for (auto &line : lines) {
+    parts[0] = ":" + line.nick;
+    if (line.cmd == CMD_ACTION)
+      parts[1] = "ACTION";
+    else if (line.cmd == CMD_NOTICE)
+      parts[1] = "NOTICE";
+    else
+      parts[1] = "PRIVMSG";
+    parts[2] = channel;
+    parts[3] = line.text;
+
+    message_ptr ms = messages_pool.get();
+    ms->assign(parts);
+    ms->stamp = line.stamp;
+    ms->target = channel_atom;
+    message_append(std::move(ms));
+    history.seen(channel, "", line.stamp, line.nick, line.text);
+  }
+}
+
+/**
+ * @brief CAP replies, while registering
+ *
+ * We ask for sasl (when there's a password), and for draft/chathistory with
+ * the caps it needs.  Anything else (or nothing offered) ends negotiation.
+ *
+ * @param parts
+ */
+void ircClient::cap_reply(const std::vector<std::string> &parts) {
+  if (parts.size() < 5)
+    return;
+  const std::string &sub = parts[3];
+  const std::string &caps = parts[parts.size() - 1];
+
+  if (sub == "LS") {
+    cap_offered += " " + caps;
+    if ((parts.size() >= 6) and (parts[4] == "*"))
+      return; // more LS lines are coming
+
+    std::set<std::string> offered;
+    std::stringstream ss(cap_offered);
+    std::string token;
+    while (ss >> token)
+      offered.insert(token.substr(0, token.find('=')));
+    cap_offered.clear();
+
+    std::string want;
+    if ((!sasl_plain_password.empty()) and (offered.count("sasl")))
+      want += " sasl";
+    std::string chathistory =
+        offered.count("chathistory") ? "chathistory" : "draft/chathistory";
+    if ((history_lines > 0) and (offered.count(chathistory)) and
+        (offered.count("batch"))) {
+      want += " batch " + chathistory;
+      if (offered.count("server-time"))
+        want += " server-time";
+      if (offered.count("message-tags"))
+        want += " message-tags";
+    }
+
+    if (want.empty())
+      write("CAP END");
+    else
+      write("CAP REQ :" + want.substr(1));
+    return;
+  }
+
+  if (sub == "ACK") {
+    std::stringstream ss(caps);
+    std::string cap;
+    bool sasl = false;
+    while (ss >> cap) {
+      if (cap == "sasl")
+        sasl = true;
+      if ((cap == "chathistory") or (cap == "draft/chathistory"))
+        cap_history = true;
+    }
+    if (sasl)
+      write("AUTHENTICATE PLAIN");
+    else
+      write("CAP END");
+    return;
+  }
+
+  if (sub == "NAK")
+    write("CAP END");
+}
+
+/**
+ * @brief ask for the channel's recent lines (draft/chathistory)
+ *
+ * @param channel
+ */
+void ircClient::history_request(const std::string &channel) {
+  if ((!cap_history) or (history_lines <= 0))
+    return;
+
+  int limit = history_lines;
+  auto pos = isupport.find("CHATHISTORY");
+  if (pos == isupport.end())
+    pos = isupport.find("draft/CHATHISTORY");
+  if ((pos != isupport.end()) and (!pos->second.empty())) {
+    int most = atoi(pos->second.c_str());
+    if ((most > 0) and (most < limit))
+      limit = most;
+  }
+  write("CHATHISTORY LATEST " + channel + " * " + std::to_string(limit));
+}
+
+/**
+ * @brief queue a finished history block, behind a CMD_HISTORY message
+ *
+ * @param block
+ */
+void ircClient::history_append(history_ptr block) {
+  lock.lock();
+  unsigned id = ++history_id;
+  history_blocks.emplace_back(id, block);
+  lock.unlock();
+
+  message_ptr ms = messages_pool.get();
+  ms->assign(std::vector<std::string>{std::to_string(id), "HISTORY",
+                                      block->channel});
+  ms->cmd = CMD_HISTORY;
+  ms->target = atom(block->channel);
+  message_append(std::move(ms));
+}
+
+/**
+ * @brief the block for a CMD_HISTORY message
+ *
+ * Blocks are in id order.  Older ones were for messages that got dropped
+ * (queue full), so they're dropped too.
+ *
+ * @param id part 0 of the message
+ * @return history_ptr or null
+ */
+history_ptr ircClient::history_pop(const std::string &id) {
+  unsigned want = (unsigned)std::stoul(id);
+  history_ptr block;
+  lock.lock();
+  while ((!history_blocks.empty()) and (history_blocks.front().first <= want)) {
+    if (history_blocks.front().first == want)
+      block = history_blocks.front().second;
+    history_blocks.pop_front();
+  }
+  lock.unlock();
+  return block;
+}
+
 /**
  * @brief thread safe messages.push_back
  *
  * @param msg
  */
-void ircClient::message_append(message_stamp &msg) {
+void ircClient::message_append(message_ptr msg) {
   lock.lock();
-  messages.push_back(msg);
+  tracer.mark(msg->trace, TRACE_QUEUED);
+  if ((int)messages.size() >= max_queue) {
+    // The queue is full, drop the oldest message.
+    messages.erase(messages.begin());
+    ++dropped_messages;
+  }
+  messages.push_back(std::move(msg));
   channels_updated = true;
   lock.unlock();
+  if (on_message)
+    on_message();
 }
 
 /**
- * @brief thread safe message_stamp pop
+ * @brief thread safe message pop
  *
- * @return boost::optional<message_stamp>
+ * @return message_ptr or nullptr when empty
  */
-boost::optional<message_stamp> ircClient::message_pop(void) {
+message_ptr ircClient::message_pop(void) {
   lock.lock();
-  message_stamp msg;
   if (messages.empty()) {
     channels_updated = false;
     lock.unlock();
-    return boost::optional<message_stamp>{};
+    return message_ptr{};
   }
-  msg = messages.front();
+  message_ptr msg = std::move(messages.front());
   messages.erase(messages.begin());
   lock.unlock();
+  tracer.mark(msg->trace, TRACE_POPPED);
   return msg;
 }
 
-void ircClient::on_resolve(
-    error_code error, boost::asio::ip::tcp::resolver::results_type results) {
-  if (logging) {
-    log() << "Resolve: " << error.message() << std::endl;
-  }
-  if (error) {
-    std::string output = "Unable to resolve (DNS Issue?): " + error.message();
-    errors.push_back(output);
-    message(output);
-    socket.async_shutdown(std::bind(&ircClient::on_shutdown, this, _1));
-  }
-  boost::asio::async_connect(socket.next_layer(), results,
-                             std::bind(&ircClient::on_connect, this, _1, _2));
-}
-
-void ircClient::on_connect(error_code error,
-                           boost::asio::ip::tcp::endpoint const &endpoint) {
-  if (logging) {
-    log() << "Connect: " << error.message() << ", endpoint: " << endpoint
-          << std::endl;
-  }
-  if (error) {
-    std::string output = "Unable to connect: " + error.message();
-    message(output);
-    errors.push_back(output);
-    socket.async_shutdown(std::bind(&ircClient::on_shutdown, this, _1));
-  }
-
-  socket.async_handshake(boost::asio::ssl::stream_base::client,
-                         std::bind(&ircClient::on_handshake, this, _1));
-}
-
-void ircClient::on_handshake(error_code error) {
+/**
+ * @brief Connected (or not) to the server
+ *
+ * @param error
+ * @param step what failed, or where we're connected
+ */
+void ircClient::on_connect(error_code error, const std::string &step) {
   if (logging) {
-    log() << "Handshake: " << error.message() << std::endl;
+    log() << "Connect (" << transport << "): " << error.message() << ", "
+          << step << std::endl;
   }
   if (error) {
-    std::string output = "Handshake Failure: " + error.message();
+    std::string output = step + ": " + error.message();
     message(output);
     errors.push_back(output);
-    socket.async_shutdown(std::bind(&ircClient::on_shutdown, this, _1));
+    link->shutdown(std::bind(&ircClient::on_shutdown, this, _1));
+    return;
   }
 
   write(registration());
-  /*
-  std::string request = registration();
-  boost::asio::async_write(socket, boost::asio::buffer(request),
-                           std::bind(&ircClient::on_write, this, _1, _2));
-  // socket.async_shutdown(std::bind(&ircClient::on_shutdown, this, _1));
-}
-
-void ircClient::on_write(error_code error, std::size_t bytes_transferred) {
-  if ((error) and (logging)) {
-    log() << "Write: " << error.message() << std::endl;
-  }
-  */
-  // << ", bytes transferred: " << bytes_transferred << "\n";
-  boost::asio::async_read_until(
-      socket, response, '\n', std::bind(&ircClient::read_until, this, _1, _2));
+  link->read_line(response, std::bind(&ircClient::read_until, this, _1, _2));
 }
 
 void ircClient::on_shutdown(error_code error) {
   if (logging) {
     log() << "SHUTDOWN: " << error.message() << std::endl;
   }
+  backlog.part_all();
   shutdown = true;
-  context.stop();
+  lag_timer.cancel();
+  if (on_closed)
+    on_closed();
+  else
+    context.stop();
 }
 
 void ircClient::read_until(error_code error, std::size_t bytes) {
   // std::cout << "Read: " << bytes << ", " << error << "\n";
   // auto data = response.data();
   if (bytes == 0) {
+    // (dead_link already shut us down)
+    if (shutdown)
+      return;
     if (logging) {
       log() << "Read 0 bytes, shutdown..." << std::endl;
     }
-    socket.async_shutdown(std::bind(&ircClient::on_shutdown, this, _1));
+    link->shutdown(std::bind(&ircClient::on_shutdown, this, _1));
     return;
   };
 
+  if (tracer.enabled())
+    read_at = trace_now();
+
   // Only try to get the data -- if we're read some bytes.
   auto data = response.data();
   response.consume(bytes);
@@ -375,9 +1001,7 @@ void ircClient::read_until(error_code error, std::size_t bytes) {
   receive(text);
 
   // repeat until closed
-
-  boost::asio::async_read_until(
-      socket, response, '\n', std::bind(&ircClient::read_until, this, _1, _2));
+  link->read_line(response, std::bind(&ircClient::read_until, this, _1, _2));
 }
 
 /**
@@ -386,17 +1010,57 @@ void ircClient::read_until(error_code error, std::size_t bytes) {
  * @param msg
  */
 void ircClient::message(std::string msg) {
-  message_stamp ms;
-  ms.buffer.push_back(msg);
-  message_append(ms);
+  message_ptr ms = messages_pool.get();
+  ms->assign(msg);
+  message_append(std::move(ms));
 }
 
 void ircClient::receive(std::string &text) {
-  message_stamp ms;
-  ms.buffer = irc_split(text);
-  std::vector<std::string> &parts = ms.buffer;
+  message_tags tags;
+  irc_tags(text, tags);
+  std::vector<std::string> &parts = parts_buffer;
+  irc_split(text, parts);
+  // anything from the server means the link is still up
+  missed_pings = 0;
+  target_atom target = nullptr;
+  bool highlight = false;
+
+  // ignore rules first, so ignored traffic costs one lookup.
+  bool hidden = false;
+  if ((!ignores->empty()) and (parts.size() >= 3) and (parts[0][0] == ':')) {
+    unsigned kind = ignore_kind(parts[1], parts[parts.size() - 1]);
+    if ((kind != 0) and (ignores->match(parts[0], parts[2]) & kind)) {
+      if (kind != IGNORE_JOINS) {
+        // the other nodes still want it (but not our history)
+        if (tags.batch.empty())
+          share_line(parts, tags.time ? tags.time : irc_clock::wall());
+        return;
+      }
+      // keep tracking the channels, but don't show it.
+      hidden = true;
+    }
+  }
 
-  if (logging) {
+  // chathistory batches are collected, and shown when they end
+  if ((parts.size() >= 3) and (parts[1] == "BATCH")) {
+    const std::string &ref = parts[2];
+    if ((ref[0] == '+') and (parts.size() >= 5) and
+        (parts[3] == "chathistory"))
+      history.open(ref.substr(1), parts[4]);
+    if (ref[0] == '-') {
+      history_ptr block = history.close(ref.substr(1), history_lines);
+      if ((block) and (!block->lines.empty()))
+        history_append(block);
+    }
+    return;
+  }
+
+  if ((!tags.batch.empty()) and (history.is_open(tags.batch))) {
+    history.add(tags.batch, parts, tags);
+    return;
+  }
+
+  if ((logging) and (log_level > 1)) {
     // this also shows our parser working
     std::ofstream &l = log();
     l << ">> ";
@@ -422,12 +1086,24 @@ void ircClient::receive(std::string &text) {
     std::string &cmd = parts[1];
     std::string &msg_to = parts[2];
 
-    std::string msg;
-    if (parts.size() >= 4) {
-      msg = parts[parts.size() - 1];
+    static const std::string no_msg;
+    const std::string &msg =
+        (parts.size() >= 4) ? parts[parts.size() - 1] : no_msg;
+
+    if ((cmd == "PONG") and (msg.compare(0, 3, "LAG") == 0)) {
+      // reply to our lag meter PING
+      lag_pong(msg);
+      return;
     }
 
-    if (logging) {
+    if ((cmd == "PRIVMSG") or (cmd == "NOTICE")) {
+      // flooders get ignored for a while
+      if (ctcp.ignore_level(parse_host(parts[0]),
+                            ctcp_responder::clock::now()) > 1)
+        return;
+    }
+
+    if ((logging) and (log_level > 1)) {
       // this also shows our parser working
       std::ofstream &l = log();
       l << "IRC: [SRC:" << source << "] [CMD:" << cmd << "] [TO:" << msg_to
@@ -435,35 +1111,48 @@ void ircClient::receive(std::string &text) {
     }
 
     if (cmd == "JOIN") {
-      channels_lock.lock();
       if (nick == source) {
         // yes, we are joining
+        self_prefix = parts[0];
         std::string output = "You have joined " + msg_to;
         message(output);
         talkto(msg_to);
         // insert empty set here.
         std::set<std::string> empty;
         channels[msg_to] = empty;
+        completion_lock.lock();
+        nick_index[msg_to] = prefix_index{};
+        completion_lock.unlock();
+        replay_backlog(msg_to);
+        history_request(msg_to);
       } else {
         // Someone else is joining
         std::string output = source + " has joined " += msg_to;
-        message(output);
+        if (!hidden)
+          message(output);
         channels[msg_to].insert(source);
+        completion_lock.lock();
+        nick_index[msg_to].insert(source);
+        completion_lock.unlock();
         if ((int)source.size() > max_nick_length)
           max_nick_length = (int)source.size();
       }
 
-      channels_lock.unlock();
+      publish_channels({msg_to});
     }
 
     if (cmd == "PART") {
-      channels_lock.lock();
       if (nick == source) {
         std::string output = "You left " + msg_to;
 
         auto ch = channels.find(msg_to);
         if (ch != channels.end())
           channels.erase(ch);
+        backlog.part(display_name(msg_to));
+        history.forget(msg_to);
+        completion_lock.lock();
+        nick_index.erase(msg_to);
+        completion_lock.unlock();
 
         if (!channels.empty()) {
           talkto(channels.begin()->first);
@@ -478,21 +1167,33 @@ void ircClient::receive(std::string &text) {
         if (!msg.empty()) {
           output += " " + msg;
         }
-        message(output);
+        if (!hidden)
+          message(output);
         channels[msg_to].erase(source);
+        completion_lock.lock();
+        nick_index[msg_to].erase(source);
+        completion_lock.unlock();
       }
 
       find_max_nick_length();
-      channels_lock.unlock();
+      publish_channels({msg_to});
     }
 
     if (cmd == "KICK") {
       std::string output =
           source + " has kicked " + parts[3] + " from " + msg_to;
 
-      channels_lock.lock();
+      completion_lock.lock();
+      if (parts[3] == nick)
+        nick_index.erase(msg_to);
+      else
+        nick_index[msg_to].erase(parts[3]);
+      completion_lock.unlock();
+
       if (parts[3] == nick) {
         channels.erase(msg_to);
+        backlog.part(display_name(msg_to));
+        history.forget(msg_to);
         if (!channels.empty()) {
           talkto(channels.begin()->first);
           output += " [talkto = " + talkto() + "]";
@@ -504,27 +1205,41 @@ void ircClient::receive(std::string &text) {
       }
 
       find_max_nick_length();
-      channels_lock.unlock();
-      message(output);
+      publish_channels({msg_to});
+      if (!hidden)
+        message(output);
     }
 
     if (cmd == "QUIT") {
       std::string output = "* " + source + " has quit ";
-      message(output);
+      if (!hidden)
+        message(output);
+
+      completion_lock.lock();
+      if (source == nick) {
+        nick_index.clear();
+      } else {
+        for (auto &ni : nick_index)
+          ni.second.erase(source);
+      }
+      completion_lock.unlock();
 
-      channels_lock.lock();
+      std::vector<std::string> changed;
       if (source == nick) {
         // We've quit?
+        for (auto const &c : channels)
+          changed.push_back(c.first);
         channels.erase(channels.begin(), channels.end());
       } else {
         for (auto &c : channels) {
-          c.second.erase(source);
+          if (c.second.erase(source) == 1)
+            changed.push_back(c.first);
           // would it be possible that channel is empty now?
           // no, because we're still in it.
         }
         find_max_nick_length();
       }
-      channels_lock.unlock();
+      publish_channels(changed);
     }
 
     if (cmd == "353") {
@@ -532,39 +1247,100 @@ void ircClient::receive(std::string &text) {
       std::vector<std::string> names_list = split_limit(msg);
       std::string channel = parts[4];
 
-      channels_lock.lock();
       if (channels.find(channel) == channels.end()) {
         // does not exist
         channels.insert({channel, std::set<std::string>{}});
       }
 
+      completion_lock.lock();
+      prefix_index &index = nick_index[channel];
       for (auto name : names_list) {
         remove_channel_modes(name);
         channels[channel].insert(name);
+        index.insert(name);
       }
+      completion_lock.unlock();
 
+      // published at the end of the names list (366)
       find_max_nick_length();
-      channels_lock.unlock();
+    }
+
+    if ((cmd == "366") and (parts.size() >= 4)) {
+      // end of NAMES list
+      publish_channels({parts[3]});
+    }
+
+    if (cmd == "005") {
+      // ISUPPORT:  me TOKEN TOKEN=value ... :are supported by this server
+      for (size_t x = 3; x + 1 < parts.size(); ++x) {
+        size_t equal = parts[x].find('=');
+        if (equal == std::string::npos)
+          isupport[parts[x]] = "";
+        else
+          isupport[parts[x].substr(0, equal)] = parts[x].substr(equal + 1);
+      }
+    }
+
+    if (chan_list.active()) {
+      if (cmd == "321")
+        return;
+      if ((cmd == "322") and (parts.size() >= 5)) {
+        // me #channel users :topic
+        chan_list.add(parts[3], std::atoi(parts[4].c_str()),
+                      (parts.size() >= 6) ? parts[5] : std::string());
+        return;
+      }
+      if ((cmd == "323") or (cmd == "416")) {
+        // end of list (or too many matches, which is shown as an error)
+        std::atomic_store(&list_result_ptr, chan_list.finish());
+        list_ready = true;
+        if (on_message)
+          on_message();
+        if (cmd == "323")
+          return;
+      }
     }
 
     if (cmd == "NICK") {
       // msg_to.erase(0, 1);
 
-      channels_lock.lock();
+      completion_lock.lock();
+      for (auto &ni : nick_index)
+        ni.second.rename(source, msg_to);
+      completion_lock.unlock();
+
+      std::vector<std::string> changed;
       for (auto &ch : channels) {
         if (ch.second.erase(source) == 1) {
           ch.second.insert(msg_to);
+          changed.push_back(ch.first);
         }
       }
       // Is this us?  If so, change our nick.
-      if (source == nick)
+      if (source == nick) {
         nick = msg_to;
+        build_highlights();
+        size_t bang = self_prefix.find('!');
+        if (bang != std::string::npos)
+          self_prefix = ":" + nick + self_prefix.substr(bang);
+      }
 
       find_max_nick_length();
-      channels_lock.unlock();
+      publish_channels(changed);
     }
 
     if (cmd == "PRIVMSG") {
+      if (msg_to[0] == '#') {
+        target = atom(msg_to);
+
+        // recent activity orders the nick completions
+        completion_lock.lock();
+        auto ni = nick_index.find(msg_to);
+        if (ni != nick_index.end())
+          ni->second.touch(source, ++activity);
+        completion_lock.unlock();
+      }
+
       // Possibly a CTCP request.  Let's see
       std::string message = msg;
       if ((message[0] == '\x01') and (message[message.size() - 1] == '\x01')) {
@@ -578,6 +1354,16 @@ void ircClient::receive(std::string &text) {
         std::vector<std::string> ctcp_cmd = split_limit(message, 2);
 
         if (ctcp_cmd[0] != "ACTION") {
+          // rate limit, and drop silently when over budget.
+          if (!ctcp.allow(parse_host(parts[0]),
+                          ctcp_responder::clock::now())) {
+            if (logging) {
+              log() << "CTCP dropped: [" << message << "] from " << parts[0]
+                    << " (" << ctcp.dropped << " dropped)" << std::endl;
+            }
+            return;
+          }
+
           std::string msg =
               "Received CTCP " + ctcp_cmd[0] + " from " + parse_nick(source);
           this->message(msg);
@@ -588,33 +1374,18 @@ void ircClient::receive(std::string &text) {
         }
 
         if (message == "VERSION") {
-          std::string reply_to = parse_nick(source);
-          boost::format fmt = boost::format("NOTICE %1% :\x01VERSION %2%\x01") %
-                              reply_to % version;
-          std::string response = fmt.str();
-          write(response);
+          write(ctcp.version_reply(source));
           return;
         }
 
         if (message.substr(0, 5) == "PING ") {
           message.erase(0, 5);
-          boost::format fmt = boost::format("NOTICE %1% :\x01PING %2%\x01") %
-                              parse_nick(source) % message;
-          std::string response = fmt.str();
-          write(response);
+          write(ctcp.ping_reply(source, message));
           return;
         }
 
         if (message == "TIME") {
-          auto now = std::chrono::system_clock::now();
-          auto in_time_t = std::chrono::system_clock::to_time_t(now);
-          std::string datetime = boost::lexical_cast<std::string>(
-              std::put_time(std::localtime(&in_time_t), "%c"));
-
-          boost::format fmt = boost::format("NOTICE %1% :\x01TIME %2%\x01") %
-                              parse_nick(source) % datetime;
-          std::string response = fmt.str();
-          write(response);
+          write(ctcp.time_reply(source));
           return;
         }
 
@@ -629,6 +1400,12 @@ void ircClient::receive(std::string &text) {
         }
       }
     }
+
+    if (((cmd == "PRIVMSG") or (cmd == "ACTION") or (cmd == "NOTICE")) and
+        (parts.size() >= 4) and (source != nick)) {
+      // one pass over the text for all of the highlight words
+      highlight = highlights->match(parts[parts.size() - 1]);
+    }
   }
 
   if (!registered) {
@@ -651,9 +1428,9 @@ void ircClient::receive(std::string &text) {
       }
     }
 
-    // SASL Authentication
-    if ((parts[1] == "CAP") and (parts[3] == "ACK")) {
-      write("AUTHENTICATE PLAIN");
+    // capabilities, and SASL Authentication
+    if (parts[1] == "CAP") {
+      cap_reply(parts);
     }
 
     if ((parts[0] == "AUTHENTICATE") and (parts[1] == "+")) {
@@ -681,7 +1458,9 @@ void ircClient::receive(std::string &text) {
     if ((parts[1] == "376") or (parts[1] == "422")) {
       // END MOTD, or MOTD MISSING
       find_max_nick_length(); // start with ourself.
+      build_highlights();     // we might not have the nick we asked for
       registered = true;
+      start_lag_timer();
       if (!autojoin.empty()) {
         std::string msg = "JOIN " + autojoin;
         write(msg);
@@ -689,7 +1468,92 @@ void ircClient::receive(std::string &text) {
     }
   }
 
-  message_append(ms);
+  if (!hidden) {
+    message_ptr ms = messages_pool.get();
+    ms->assign(parts);
+    if (tags.time)
+      ms->stamp = tags.time;
+    if (((ms->cmd == CMD_PRIVMSG) or (ms->cmd == CMD_ACTION) or
+         (ms->cmd == CMD_NOTICE)) and
+        (parts.size() >= 4) and (parts[2][0] == '#')) {
+      std::string from = parse_nick(parts[0]);
+      transcripts.append(display_name(parts[2]), ms->cmd, from,
+                         parts[parts.size() - 1], ms->stamp);
+      history.seen(parts[2], tags.msgid, ms->stamp, from,
+                   parts[parts.size() - 1]);
+    }
+    share_line(parts, ms->stamp);
+    ms->target = target;
+    ms->highlight = highlight;
+    ms->trace.at[TRACE_READ] = read_at;
+    tracer.mark(ms->trace, TRACE_PARSED);
+    message_append(std::move(ms));
+  }
+}
+
+/**
+ * @brief nicks in channel starting with prefix
+ *
+ * Most recently active first.  Our own nick isn't included.
+ *
+ * @param channel
+ * @param prefix
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> ircClient::complete_nick(const std::string &channel,
+                                                  const std::string &prefix) {
+  std::vector<std::string> results;
+  completion_lock.lock();
+  auto ni = nick_index.find(channel);
+  if (ni != nick_index.end())
+    results = ni->second.complete(prefix);
+  completion_lock.unlock();
+
+  results.erase(std::remove(results.begin(), results.end(), nick),
+                results.end());
+  return results;
+}
+
+/**
+ * @brief interned target for the io_context thread
+ *
+ * Cached, so after the first time we see a target there's no locking.
+ *
+ * @param name
+ * @return target_atom
+ */
+target_atom ircClient::atom(const std::string &name) {
+  auto a = atoms.find(name);
+  if (a != atoms.end())
+    return a->second;
+  target_atom ta = intern_target(name);
+  atoms[name] = ta;
+  return ta;
+}
+
+/**
+ * @brief publish a new channels snapshot
+ *
+ * Only the changed channels get copied, the rest of the snapshot shares the
+ * previous nick sets.  Channels we are no longer in are removed.
+ *
+ * @param changed
+ */
+void ircClient::publish_channels(const std::vector<std::string> &changed) {
+  snapshot_ptr current = std::atomic_load(&snapshot);
+  auto next = std::make_shared<channel_snapshot>();
+  next->version = current->version + 1;
+  next->channels = current->channels;
+
+  for (auto const &name : changed) {
+    auto ch = channels.find(name);
+    if (ch == channels.end())
+      next->channels.erase(name);
+    else
+      next->channels[name] = std::make_shared<const nick_set>(ch->second);
+  }
+
+  std::atomic_store(&snapshot, snapshot_ptr(next));
 }
 
 /**
@@ -718,10 +1582,8 @@ void ircClient::find_max_nick_length(void) {
 std::string ircClient::registration(void) {
   std::string text;
 
-  // Initiate SASL authentication
-  if (!sasl_plain_password.empty()) {
-    text = "CAP REQ :sasl\r\n";
-  }
+  // capabilities (SASL, chathistory), cap_reply() ends this
+  text = "CAP LS 302\r\n";
 
   if (!server_password.empty()) {
     text += "PASS " + server_password + "\r\n";
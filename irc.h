@@ -1,7 +1,6 @@
 #ifndef IRC_H
 #define IRC_H
 #include <boost/asio.hpp>
-#include <boost/asio/ssl.hpp>
 
 #include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
@@ -13,28 +12,57 @@
 // #include <vector>
 #include <algorithm>
 #include <ctime> // time_t
+#include <deque>
 #include <fstream>
+#include <map>
+#include <memory>
 #include <set>
 
 #include <boost/asio/io_context.hpp>
 
+#include "backlog.h"
+#include "chanlist.h"
+#include "clock.h"
+#include "complete.h"
+#include "ctcp.h"
+#include "highlight.h"
+#include "history.h"
+#include "ignore.h"
+#include "message.h"
+#include "transport.h"
+
 #define SENDQ
 
 std::string base64encode(const std::string &str);
 void string_toupper(std::string &str);
 
-std::vector<std::string> split_limit(std::string &text, int max = -1);
+std::vector<std::string> split_limit(const std::string &text, int max = -1);
 std::vector<std::string> irc_split(std::string &text);
-std::string parse_nick(std::string &name);
+void irc_split(const std::string &text, std::vector<std::string> &results);
+std::vector<std::string> split_text(const std::string &text, size_t max_bytes);
+std::string parse_nick(const std::string &name);
 void remove_channel_modes(std::string &nick);
 
-class message_stamp {
+// target_atom is in message.h
+target_atom intern_target(const std::string &name);
+
+typedef std::set<std::string> nick_set;
+
+/**
+ * @brief Immutable channels / users, published by the io_context thread.
+ *
+ * Readers get the current version with one atomic load, and can keep using
+ * it as long as they like.  Unchanged channels share their nick_set with the
+ * previous version.
+ */
+class channel_snapshot {
 public:
-  message_stamp() { time(&stamp); }
-  std::time_t stamp;
-  std::vector<std::string> buffer;
+  unsigned long version = 0;
+  std::map<std::string, std::shared_ptr<const nick_set>> channels;
 };
 
+typedef std::shared_ptr<const channel_snapshot> snapshot_ptr;
+
 // using error_code = boost::system::error_code;
 
 class ircClient {
@@ -49,14 +77,24 @@ public:
   // thread-safe write to IRC
   void write(std::string output);
 #ifdef SENDQ
-  // queued writer
+  // queued writer (thread-safe)
   void write_queue(std::string target, std::string output);
   void on_sendq(error_code error);
 #endif
+  // PRIVMSG / NOTICE / ACTION, split to fit the server's line length
+  void send_text(const std::string &cmd, const std::string &target,
+                 const std::string &text);
+  // pasted lines, paced through the sendq
+  void send_paste(const std::string &target,
+                  const std::vector<std::string> &texts);
 
   // configuration
   std::string hostname;
   std::string port;
+  // tls, tcp or unix (hostname is the socket's path)
+  std::string transport = "tls";
+  // before begin():  run over this instead (memory_transport)
+  void use_transport(std::unique_ptr<irc_transport> link);
   std::string server_password;
   std::string nick;
   std::string sasl_plain_password;
@@ -64,64 +102,144 @@ public:
   std::string realname;
   std::string autojoin;
   std::string version;
+  // network name, when the door has more than one
+  std::string network;
+  std::string display_name(const std::string &target) const {
+    if (network.empty())
+      return target;
+    return network + "/" + target;
+  }
+  // recent channel lines shared with the other nodes (empty is off)
+  std::string backlog_dir;
+  int backlog_lines = 20;
+  // draft/chathistory lines to fetch on join (0 is off)
+  int history_lines = 50;
 
   // filename to use for logfile
   std::string debug_output;
   std::ofstream debug_file;
 
+  // tunables, these can change while we're running
+  void tune(int sendq_ms, int max_queue, int log_level);
+  void ignore(ignore_ptr matcher);
+  void highlight_words(const std::string &words);
+  void lag_check(int interval_seconds, int missed);
+
+  // round trip time of our last PING, 0 until we have one
+  std::atomic<int> lag_ms;
+  // lag_histogram[x] counts replies under lag_buckets[x] ms
+  static const int LAG_BUCKETS = 8;
+  static const int lag_buckets[LAG_BUCKETS];
+  std::atomic<unsigned> lag_histogram[LAG_BUCKETS];
+
+  // /list, results are published when the list ends
+  void list(const list_filter &filter);
+  list_ptr list_results(void) { return std::atomic_load(&list_result_ptr); }
+  std::atomic<bool> list_ready;
+
 protected:
-  boost::signals2::mutex talkto_lock;
-  std::string _talkto;
+  std::atomic<target_atom> _talkto;
 
 public:
-  std::string talkto(void) {
-    talkto_lock.lock();
-    std::string ret{_talkto};
-    talkto_lock.unlock();
-    return ret;
-  };
+  const std::string &talkto(void) const { return *_talkto.load(); };
+  target_atom talkto_atom(void) const { return _talkto.load(); };
 
-  void talkto(std::string talkvalue) {
-    talkto_lock.lock();
-    _talkto = talkvalue;
-    talkto_lock.unlock();
+  void talkto(const std::string &talkvalue) {
+    _talkto = intern_target(talkvalue);
   };
 
   // channels / users
   std::atomic<bool> channels_updated;
-  boost::signals2::mutex channels_lock;
-  std::map<std::string, std::set<std::string>> channels;
   std::atomic<int> max_nick_length;
 
+  // current channels snapshot, safe from any thread
+  snapshot_ptr channels_snapshot(void) { return std::atomic_load(&snapshot); }
+
+  // tab completion
+  std::vector<std::string> complete_nick(const std::string &channel,
+                                         const std::string &prefix);
+
   void message(std::string msg);
   std::atomic<bool> shutdown;
 
   // thread-safe messages access
-  virtual void message_append(message_stamp &msg);
-  boost::optional<message_stamp> message_pop(void);
+  virtual void message_append(message_ptr msg);
+  // called after message_append (from the io_context thread)
+  std::function<void(void)> on_message;
+  // called when the connection is closed (io_context thread), without it
+  // the io_context is stopped
+  std::function<void(void)> on_closed;
+  message_ptr message_pop(void);
+  // the block for a CMD_HISTORY message (part 0 is its id)
+  history_ptr history_pop(const std::string &id);
 
   std::vector<std::string> errors;
   std::atomic<bool> registered;
+  // messages dropped because the queue was full
+  std::atomic<int> dropped_messages;
 
 private:
   void find_max_nick_length(void);
+  void publish_channels(const std::vector<std::string> &changed);
+
+  // channels / users (io_context thread only)
+  std::map<std::string, nick_set> channels;
+  std::map<std::string, target_atom> atoms;
+  target_atom atom(const std::string &name);
+
+  // io_context thread only
+  ctcp_responder ctcp;
+  ignore_ptr ignores;
+  highlight_ptr highlights;
+  std::string highlight_custom;
+  void build_highlights(void);
+  // RPL_ISUPPORT (005) tokens
+  std::map<std::string, std::string> isupport;
+  // our :nick!user@host, as the server sees it (from our JOIN)
+  std::string self_prefix;
+  size_t text_budget(size_t overhead);
+  void queue_text(const std::string &cmd, const std::string &target,
+                  const std::string &text, bool now);
+  channel_backlog backlog;
+  void share_line(const std::vector<std::string> &parts, std::time_t stamp);
+  void replay_backlog(const std::string &channel);
+  // IRCv3 capabilities (CAP LS 302), and draft/chathistory batches
+  std::string cap_offered;
+  bool cap_history = false;
+  void cap_reply(const std::vector<std::string> &parts);
+  history_batches history;
+  void history_request(const std::string &channel);
+  void history_append(history_ptr block);
+#ifdef SENDQ
+  void send_line(const std::string &target, const std::string &output);
+#endif
+  channel_list chan_list;
+  list_ptr list_result_ptr;
+
+  boost::signals2::mutex completion_lock;
+  std::map<std::string, prefix_index> nick_index;
+  unsigned long activity;
+  snapshot_ptr snapshot;
+
   boost::signals2::mutex lock;
-  std::vector<message_stamp> messages;
+  std::vector<message_ptr> messages;
+  std::deque<std::pair<unsigned, history_ptr>> history_blocks;
+  unsigned history_id = 0;
+  // receive() parses into this, so the strings are reused
+  std::vector<std::string> parts_buffer;
 
   std::string original_nick;
   int nick_retry;
 
-  bool logging;
+  // debug_file is open and log_level > 0 (see open_log)
+  std::atomic<bool> logging;
+  std::atomic<int> log_level;
+  std::atomic<int> max_queue;
   std::ofstream &log(void);
+  void open_log(void);
 
   // async callbacks
-  void on_resolve(error_code error,
-                  boost::asio::ip::tcp::resolver::results_type results);
-  void on_connect(error_code error,
-                  boost::asio::ip::tcp::endpoint const &endpoint);
-
-  void on_handshake(error_code error);
-  void on_write(error_code error, std::size_t bytes_transferred);
+  void on_connect(error_code error, const std::string &step);
   void read_until(error_code error, std::size_t bytes);
   void on_shutdown(error_code error);
   // end async callback
@@ -130,23 +248,30 @@ private:
 
   std::string registration(void);
 
-  // initialization order matters for socket, ssl_context!
-  //
-  // socket up here causes segmentation fault!
-  // boost::asio::ssl::stream<ip::tcp::socket> socket;
-
-  boost::asio::ip::tcp::resolver resolver;
-  boost::asio::ssl::context ssl_context;
+  std::unique_ptr<irc_transport> link;
   boost::asio::streambuf response;
-  boost::asio::ssl::stream<boost::asio::ip::tcp::socket> socket;
+  // when read_until() got the line being received (tracing)
+  int64_t read_at = 0;
+
+  // lag meter / watchdog (io_context thread)
+  irc_timer lag_timer;
+  bool ping_outstanding;
+  int missed_pings;
+  std::atomic<int> ping_interval;
+  std::atomic<int> ping_missed;
+  void start_lag_timer(void);
+  void on_lag_timer(error_code error);
+  void lag_pong(const std::string &token);
+  void dead_link(void);
 
 #ifdef SENDQ
-  boost::asio::high_resolution_timer sendq_timer;
+  irc_timer sendq_timer;
   std::map<std::string, std::vector<std::string>> sendq;
   std::vector<std::string> sendq_targets;
   int sendq_current;
   std::atomic<bool> sendq_active;
-  int sendq_ms;
+  std::atomic<int> sendq_ms;
+  int sendq_delay(void);
 #endif
 
   boost::asio::io_context &context;
@@ -4,177 +4,178 @@
 #include <string>
 #include <thread> // sleep_for
 
+#include "config.h"
 #include "door.h"
+#include "encoding.h"
+#include "focus.h"
 #include "input.h"
 #include "irc.h"
+#include "networks.h"
+#include "reactor.h"
 #include "render.h"
-#include "yaml-cpp/yaml.h"
+#include "theme.h"
+#include "trace.h"
+#include "transcript.h"
 
 #include <boost/asio.hpp>
 // #include <boost/thread.hpp>
 
-YAML::Node config;
 std::function<std::ofstream &(void)> get_logger;
 
-bool file_exists(const std::string name) {
-  std::ifstream f(name.c_str());
-  return f.good();
-}
-
 int main(int argc, char *argv[]) {
   using namespace std::chrono_literals;
 
   boost::asio::io_context io_context;
-  ircClient irc(io_context);
 
   door::Door door("irc-door", argc, argv);
   get_logger = [&door]() -> ofstream & { return door.log(); };
 
-  if (file_exists("irc-door.yaml")) {
-    config = YAML::LoadFile("irc-door.yaml");
-  }
-
-  bool update_config = false;
-
-  if (!config["hostname"]) {
-    config["hostname"] = "127.0.0.1";
-    update_config = true;
-  }
-
-  if (!config["port"]) {
-    config["port"] = "6697";
-    update_config = true;
-  }
-
-  if (!config["allow_join"]) {
-    config["allow_join"] = "0";
-    update_config = true;
-  }
-
-  if (!config["autojoin"]) {
-    config["autojoin"] = "#bugz";
-    update_config = true;
-  }
-
-  if (!config["realname"]) {
-    config["realname"] = "A poor soul on BZBZ BBS...";
-    update_config = true;
-  }
-
-  if (!config["username"]) {
-    config["username"] = "bzbz";
-    update_config = true;
-  }
-
-  if (!config["input_delay"]) {
-    config["input_delay"] = "500";
-    update_config = true;
-  }
-
-  if (!config["timestamp_format"]) {
-    config["timestamp_format"] = "%T";
-    update_config = true;
-  }
-
-  if (update_config) {
-    std::ofstream fout("irc-door.yaml");
-    fout << "# IRC Chat Door configuration" << std::endl;
-    fout << "# to add comments (that don't get destroyed)" << std::endl;
-    fout << "# Add comments as key: values, like:" << std::endl;
-    fout << "# _comment: This will survive the test of time." << std::endl;
-    fout << "# %r AM/PM, %T 24 hour time" << std::endl;
-    fout << std::endl;
-    fout << config << std::endl;
-    fout << "# end yaml config" << std::endl;
-  }
-
-  // configure
-  irc.nick = door.handle;
-  irc.realname = config["realname"].as<std::string>();
-  irc.hostname = config["hostname"].as<std::string>();
-  irc.port = config["port"].as<std::string>();
-
-  if (config["server_password"]) {
-    irc.server_password = config["server_password"].as<std::string>();
-  }
-
-  if (config["sasl_password"]) {
-    irc.sasl_plain_password = config["sasl_password"].as<std::string>();
-  }
-
-  irc.username = config["username"].as<std::string>();
-  irc.autojoin = config["autojoin"].as<std::string>();
-  irc.version = "Bugz IRC Door 0.1 (C) 2021 Red-Green Software";
-
-  // set the delay between irc updates
-  ms_input_delay = config["input_delay"].as<int>();
-  timestamp_format = config["timestamp_format"].as<std::string>();
-
-  if (config["log"]) {
-    irc.debug_output = config["log"].as<std::string>();
-    door << "irc debug logfile = " << config["log"].as<std::string>()
-         << door::nl;
-  }
-
-  if (config["allow_join"].as<int>() == 1) {
-    allow_part = true;
-    allow_join = true;
-  }
+  const std::string config_file = "irc-door.yaml";
+
+  // add missing defaults (locked, so nodes starting together don't collide)
+  if (!ensure_config_defaults(config_file)) {
+    door << "Unable to update " << config_file << door::nl;
+  }
+
+  std::vector<std::string> problems;
+  config_ptr cfg = load_config(config_file, problems);
+  if (cfg)
+    publish_config(cfg);
+  else
+    cfg = current_config();
+
+  for (auto &problem : problems) {
+    door.log() << "CONFIG: " << problem << std::endl;
+  }
+
+  door_encoding = select_encoding(cfg->encoding);
+
+  // compiled after the encoding is known, the theme's text is in it
+  problems.clear();
+  theme.load(cfg->theme, problems);
+  for (auto &problem : problems) {
+    door.log() << "THEME: " << problem << std::endl;
+  }
+  focus.enable(door, cfg->focus);
+  tracer.enable(cfg->trace_sample, cfg->trace_dir, door.node);
+
+  // per user ignore rules
+  user_ignores.load(ignore_filename(cfg->ignore_dir, door.handle));
+
+  // configure, one ircClient per network (all on io_context)
+  for (auto const &net : config_networks(*cfg)) {
+    ircClient &irc = networks.add(io_context, net.name);
+    irc.nick = door.handle;
+    irc.realname = cfg->realname;
+    irc.hostname = net.hostname;
+    irc.port = net.port;
+    irc.transport = net.transport;
+    irc.server_password = net.server_password;
+    irc.sasl_plain_password = net.sasl_password;
+    irc.username = cfg->username;
+    irc.autojoin = net.autojoin;
+    irc.version = "Bugz IRC Door 0.1 (C) 2021 Red-Green Software";
+    irc.backlog_dir = cfg->backlog_dir;
+    irc.backlog_lines = cfg->backlog_lines;
+    irc.history_lines = cfg->history_lines;
+    irc.tune(cfg->sendq_ms, cfg->max_queue, cfg->log_level);
+    irc.highlight_words(cfg->highlight);
+    irc.lag_check(cfg->ping_interval, cfg->ping_missed);
+    irc.ignore(user_ignores.compile());
+    // the io_context keeps going until every network has closed
+    irc.on_closed = [&io_context]() -> void {
+      if (networks.closed())
+        io_context.stop();
+    };
+
+    if (!cfg->log.empty()) {
+      irc.debug_output = cfg->log;
+      if (!net.name.empty())
+        irc.debug_output += "." + net.name;
+      door << "irc debug logfile = " << irc.debug_output << door::nl;
+    }
+  }
+
+  // channel transcripts, for /search and /history
+  if (!cfg->transcript_dir.empty())
+    transcripts.begin(transcript_directory(cfg->transcript_dir, door.handle));
+
+  // live reload:  the io_context thread applies the tunables.
+  config_watcher watcher(
+      io_context, config_file,
+      [](config_ptr cfg, std::vector<std::string> &problems) -> void {
+        for (auto &problem : problems) {
+          (*networks.begin())->message("Config: " + problem);
+        }
+        if (cfg) {
+          for (auto &irc : networks) {
+            irc->tune(cfg->sendq_ms, cfg->max_queue, cfg->log_level);
+            irc->highlight_words(cfg->highlight);
+            irc->lag_check(cfg->ping_interval, cfg->ping_missed);
+          }
+        }
+      });
+  watcher.begin();
 
-  irc.begin(); // start the initial request so io_context has work to do
-  // boost::thread thread(boost::bind(&boost::asio::io_service::run,
-  // &io_context));
-  // thread Thread(boost::bind(&boost::asio::io_service::run, &io_context));
-  thread Thread([&io_context]() -> void { io_context.run(); });
+  // start the initial requests so io_context has work to do
+  for (auto &irc : networks)
+    irc->begin();
 
   door << "Welcome to the IRC chat door." << door::nl;
+  input_layout(door, cfg->input_layout);
 
-  bool in_door = true;
+  door_reactor reactor(io_context, door);
 
-  while (in_door) {
-    // the main loop
-    // custom input routine goes here
+  if (cfg->single_reactor and reactor.begin()) {
+    // input and irc share the io_context, this returns on shutdown.
+    io_context.run();
+  } else {
+    // boost::thread thread(boost::bind(&boost::asio::io_service::run,
+    // &io_context));
+    // thread Thread(boost::bind(&boost::asio::io_service::run,
+    // &io_context));
+    thread Thread([&io_context]() -> void { io_context.run(); });
 
-    check_for_input(door, irc);
+    bool in_door = true;
 
-    boost::optional<message_stamp> msg;
-    bool input_cleared = false;
+    while (in_door) {
+      // the main loop
+      // custom input routine goes here
 
-    if (irc.channels_updated)
-      do {
-        msg = irc.message_pop();
+      check_for_input(door, networks.active());
+      for (auto &irc : networks)
+        render_queue(door, *irc);
 
-        if (msg) {
-          if (!input_cleared) {
-            input_cleared = true;
-            clear_input(door);
-          }
-
-          render(*msg, door, irc);
-        }
-      } while (msg);
+      // sleep is done in the check_for_input
+      // std::this_thread::sleep_for(200ms);
+      if (networks.closed())
+        in_door = false;
+    }
 
-    if (input_cleared)
-      restore_input(door);
-
-    // sleep is done in the check_for_input
-    // std::this_thread::sleep_for(200ms);
-    if (irc.shutdown)
-      in_door = false;
+    io_context.stop();
+    Thread.join();
   }
 
+  // flush the transcripts
+  transcripts.end();
+
   // Store error messages into door log!
-  while (!irc.errors.empty()) {
-    door.log() << "ERROR: " << irc.errors.front() << std::endl;
-    irc.errors.erase(irc.errors.begin());
+  for (auto &irc : networks) {
+    while (!irc->errors.empty()) {
+      door.log() << "ERROR: " << irc->errors.front() << std::endl;
+      irc->errors.erase(irc->errors.begin());
+    }
   }
 
-  io_context.stop();
-  Thread.join();
+  // the ircClients go before the io_context does
+  tracer.end_session();
+  focus.end_session();
+  networks.end_session();
 
   // disable the global logging std::function
   get_logger = nullptr;
 
+  input_layout_end(door);
   door << "Returning to the BBS..." << door::nl;
 
   return 0;
@@ -0,0 +1,141 @@
+#include "message.h"
+#include "clock.h"
+
+#include <cctype>
+#include <cstring>
+
+message_pool messages_pool;
+
+static const struct {
+  const char *name;
+  message_cmd cmd;
+} cmd_names[] = {
+    {"PRIVMSG", CMD_PRIVMSG}, {"NOTICE", CMD_NOTICE}, {"ACTION", CMD_ACTION},
+    {"JOIN", CMD_JOIN},       {"PART", CMD_PART},     {"KICK", CMD_KICK},
+    {"QUIT", CMD_QUIT},       {"NICK", CMD_NICK},     {"TOPIC", CMD_TOPIC},
+    {"MODE", CMD_MODE},
+};
+
+message_cmd message_command(const std::string &cmd) {
+  // numerics are the most common, skip the table for them
+  if ((cmd.empty()) or (isdigit((unsigned char)cmd[0])))
+    return CMD_OTHER;
+
+  for (auto const &cn : cmd_names) {
+    if (std::strcmp(cmd.c_str(), cn.name) == 0)
+      return cn.cmd;
+  }
+  return CMD_OTHER;
+}
+
+void message_stamp::clear(void) {
+  stamp = irc_clock::wall();
+  trace = trace_times{};
+  target = nullptr;
+  highlight = false;
+  cmd = CMD_OTHER;
+  count = 0;
+  offsets[0] = 0;
+  payload.clear(); // keeps the capacity
+}
+
+/**
+ * @brief pack the parts into the payload
+ *
+ * Anything past MAX_PARTS is joined (with spaces) into the last part.
+ *
+ * @param parts
+ */
+void message_stamp::assign(const std::vector<std::string> &parts) {
+  payload.clear();
+  count = 0;
+  offsets[0] = 0;
+
+  for (size_t x = 0; x < parts.size(); ++x) {
+    if ((x >= MAX_PARTS) and (count > 0)) {
+      // over the limit, extend the last part
+      --count;
+      payload += ' ';
+    }
+    payload += parts[x];
+    if (payload.size() > 0xffff)
+      payload.resize(0xffff);
+    ++count;
+    offsets[count] = (unsigned short)payload.size();
+  }
+
+  if (count >= 2)
+    cmd = message_command(parts[1]);
+  else
+    cmd = (count == 1) ? CMD_SYSTEM : CMD_OTHER;
+}
+
+void message_stamp::assign(const std::string &system_message) {
+  payload.assign(system_message, 0, 0xffff);
+  count = 1;
+  offsets[0] = 0;
+  offsets[1] = (unsigned short)payload.size();
+  cmd = CMD_SYSTEM;
+}
+
+/**
+ * @brief copy the parts out
+ *
+ * The strings in parts are reused, so a long lived parts vector doesn't
+ * allocate.
+ *
+ * @param parts
+ */
+void message_stamp::unpack(std::vector<std::string> &parts) const {
+  parts.resize(count);
+  for (int x = 0; x < count; ++x)
+    parts[x].assign(data(x), length(x));
+}
+
+void message_release::operator()(message_stamp *msg) const {
+  messages_pool.release(msg);
+}
+
+message_pool::~message_pool() {
+  for (auto msg : free_list)
+    delete msg;
+}
+
+/**
+ * @brief get a (cleared) message
+ *
+ * @return message_ptr goes back to the pool when released.
+ */
+message_ptr message_pool::get(void) {
+  message_stamp *msg = nullptr;
+
+  lock.lock();
+  if (!free_list.empty()) {
+    msg = free_list.back();
+    free_list.pop_back();
+  }
+  lock.unlock();
+
+  if (msg == nullptr)
+    msg = new message_stamp;
+  else
+    msg->clear();
+  return message_ptr{msg};
+}
+
+void message_pool::release(message_stamp *msg) {
+  if (msg == nullptr)
+    return;
+
+  if (msg->payload.capacity() > MAX_PAYLOAD)
+    std::string().swap(msg->payload);
+
+  lock.lock();
+  if (free_list.size() < MAX_FREE) {
+    free_list.push_back(msg);
+    msg = nullptr;
+  }
+  lock.unlock();
+
+  delete msg;
+}
@@ -0,0 +1,112 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <boost/signals2/mutex.hpp>
+#include <ctime> // time_t
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+/**
+ * @brief Interned target (channel/nick) name.
+ *
+ * The same name always gives the same pointer, so targets compare with ==.
+ * Interned names are never freed, they're safe to use from any thread.
+ */
+typedef const std::string *target_atom;
+
+// message command, so render doesn't have to compare strings
+enum message_cmd : unsigned char {
+  CMD_OTHER = 0, // numerics, and everything else
+  CMD_SYSTEM,    // our own (one part) messages
+  CMD_PRIVMSG,
+  CMD_NOTICE,
+  CMD_ACTION,
+  CMD_JOIN,
+  CMD_PART,
+  CMD_KICK,
+  CMD_QUIT,
+  CMD_NICK,
+  CMD_TOPIC,
+  CMD_MODE,
+  CMD_HISTORY, // a chathistory block (ircClient::history_pop)
+};
+
+message_cmd message_command(const std::string &cmd);
+
+/**
+ * @brief Compact message
+ *
+ * A small header (time, command, part offsets) and the parts packed end to
+ * end in one payload.  The payload keeps its capacity when the message goes
+ * back to the message_pool, so a recycled message doesn't allocate.
+ */
+class message_stamp {
+public:
+  static const int MAX_PARTS = 24;
+
+  message_stamp() { clear(); }
+  void clear(void);
+
+  void assign(const std::vector<std::string> &parts);
+  void assign(const std::string &system_message);
+
+  int size(void) const { return count; }
+  const char *data(int part) const { return payload.data() + offsets[part]; }
+  int length(int part) const { return offsets[part + 1] - offsets[part]; }
+  std::string part(int part) const {
+    return std::string(data(part), length(part));
+  }
+  void unpack(std::vector<std::string> &parts) const;
+
+  std::time_t stamp;
+  // channel target of PRIVMSG/ACTION, or nullptr
+  target_atom target;
+  // mentions our nick or a highlight word
+  bool highlight;
+  message_cmd cmd;
+  // stage times, when tracing
+  trace_times trace;
+
+private:
+  friend class message_pool;
+
+  unsigned char count;
+  unsigned short offsets[MAX_PARTS + 1];
+  std::string payload;
+};
+
+/**
+ * @brief returns messages to the pool (for message_ptr)
+ */
+struct message_release {
+  void operator()(message_stamp *msg) const;
+};
+
+typedef std::unique_ptr<message_stamp, message_release> message_ptr;
+
+/**
+ * @brief Recycled messages, shared by the io_context and render threads.
+ */
+class message_pool {
+public:
+  ~message_pool();
+
+  message_ptr get(void);
+  void release(message_stamp *msg);
+
+private:
+  // keep at most this many free
+  static const size_t MAX_FREE = 1024;
+  // don't hold on to payloads bigger than this
+  static const size_t MAX_PAYLOAD = 4096;
+
+  boost::signals2::mutex lock;
+  std::vector<message_stamp *> free_list;
+};
+
+extern message_pool messages_pool;
+
+#endif
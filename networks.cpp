@@ -0,0 +1,106 @@
+#include "networks.h"
+
+network_set networks;
+
+/**
+ * @brief add a network
+ *
+ * @param io_context
+ * @param name empty when it's the only network
+ * @return ircClient&
+ */
+ircClient &network_set::add(boost::asio::io_context &io_context,
+                            const std::string &name) {
+  clients.emplace_back(new ircClient(io_context));
+  clients.back()->network = name;
+  return *clients.back();
+}
+
+/**
+ * @brief the network a network/target names
+ *
+ * @param target network/ is removed, if it's a known network
+ * @return size_t the network, or clients.size() if there isn't one
+ */
+size_t network_set::named(std::string &target) const {
+  size_t slash = target.find('/');
+  if ((clients.size() > 1) and (slash != std::string::npos)) {
+    for (size_t x = 0; x < clients.size(); ++x) {
+      if (irc_fold(clients[x]->network) == irc_fold(target.substr(0, slash))) {
+        target.erase(0, slash + 1);
+        return x;
+      }
+    }
+  }
+  return clients.size();
+}
+
+/**
+ * @brief switch networks, for a network/target
+ *
+ * A target without a known network/ stays on the active network.
+ *
+ * @param target network/ is removed
+ * @return ircClient& the (now) active network
+ */
+ircClient &network_set::select(std::string &target) {
+  size_t x = named(target);
+  if (x < clients.size())
+    current = x;
+  return active();
+}
+
+/**
+ * @brief the network for a network/target, without switching to it
+ *
+ * @param target network/ is removed
+ * @return ircClient& the named network, or the active one
+ */
+ircClient &network_set::route(std::string &target) {
+  size_t x = named(target);
+  if (x < clients.size())
+    return *clients[x];
+  return active();
+}
+
+/**
+ * @brief send to every network (QUIT)
+ */
+void network_set::write_all(const std::string &line) {
+  for (auto &client : clients) {
+    if (!client->shutdown)
+      client->write(line);
+  }
+}
+
+/**
+ * @brief the network input goes to
+ *
+ * If it has shut down, the next one still up becomes active.
+ *
+ * @return ircClient&
+ */
+ircClient &network_set::active(void) {
+  if (clients[current]->shutdown) {
+    for (size_t x = 0; x < clients.size(); ++x) {
+      if (!clients[x]->shutdown) {
+        current = x;
+        break;
+      }
+    }
+  }
+  return *clients[current];
+}
+
+/**
+ * @brief have all of the networks shut down?
+ *
+ * @return true
+ */
+bool network_set::closed(void) const {
+  for (auto const &client : clients) {
+    if (!client->shutdown)
+      return false;
+  }
+  return true;
+}
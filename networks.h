@@ -0,0 +1,51 @@
+#ifndef NETWORKS_H
+#define NETWORKS_H
+
+#include "irc.h"
+
+#include <boost/asio/io_context.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The IRC networks of this door session
+ *
+ * Every ircClient runs on the one io_context.  Input goes to the active
+ * network (the one we're talking to), render goes over all of them.  With
+ * more than one network, targets are network/#channel.
+ *
+ * select() switches networks (/join, /talkto), route() just finds the
+ * network for a target (/part, /msg, /notice, /search, /history).
+ *
+ * add() is only for startup.  active(), select() and route() are for the
+ * input thread, closed() is safe from any thread.
+ */
+class network_set {
+public:
+  typedef std::vector<std::unique_ptr<ircClient>> client_list;
+
+  ircClient &add(boost::asio::io_context &io_context, const std::string &name);
+
+  size_t size(void) const { return clients.size(); }
+  client_list::iterator begin(void) { return clients.begin(); }
+  client_list::iterator end(void) { return clients.end(); }
+
+  ircClient &active(void);
+  ircClient &select(std::string &target);
+  ircClient &route(std::string &target);
+
+  void write_all(const std::string &line);
+  bool closed(void) const;
+  void end_session(void) { clients.clear(); }
+
+private:
+  size_t named(std::string &target) const;
+
+  client_list clients;
+  size_t current = 0;
+};
+
+extern network_set networks;
+
+#endif
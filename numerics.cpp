@@ -0,0 +1,208 @@
+#include "numerics.h"
+
+#include <cctype>
+
+namespace {
+
+struct numeric_entry {
+  int numeric;
+  numeric_format format;
+};
+
+// The replies we know how to show.  Everything else 400-599 is an error,
+// everything else is hidden.
+constexpr numeric_entry numeric_entries[] = {
+    // welcome
+    {1, {"$t", NUMERIC_INFO, NUMERIC_NORMAL}},
+    {2, {"$t", NUMERIC_INFO, NUMERIC_NORMAL}},
+    {3, {"$t", NUMERIC_INFO, NUMERIC_NORMAL}},
+    {4, {"$1 $2 $3 $4", NUMERIC_INFO, NUMERIC_VERBOSE}},
+    {5, {"$* $t", NUMERIC_INFO, NUMERIC_VERBOSE}},
+    {42, {"$1 $t", NUMERIC_INFO, NUMERIC_VERBOSE}},
+
+    // lusers
+    {251, {"$t", NUMERIC_INFO, NUMERIC_VERBOSE}},
+    {252, {"$1 $t", NUMERIC_INFO, NUMERIC_VERBOSE}},
+    {253, {"$1 $t", NUMERIC_INFO, NUMERIC_VERBOSE}},
+    {254, {"$1 $t", NUMERIC_INFO, NUMERIC_VERBOSE}},
+    {255, {"$t", NUMERIC_INFO, NUMERIC_VERBOSE}},
+    {265, {"$t", NUMERIC_INFO, NUMERIC_VERBOSE}},
+    {266, {"$t", NUMERIC_INFO, NUMERIC_VERBOSE}},
+
+    // away
+    {301, {"$1 is away: $t", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {305, {"$t", NUMERIC_INFO, NUMERIC_NORMAL}},
+    {306, {"$t", NUMERIC_INFO, NUMERIC_NORMAL}},
+
+    // whois / whowas
+    {311, {"$1 is $2@$3 ($t)", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {312, {"$1 using $2 ($t)", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {313, {"$1 $t", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {314, {"$1 was $2@$3 ($t)", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {317, {"$1 has been idle $2 seconds", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {318, {"$1 $t", NUMERIC_WHOIS, NUMERIC_VERBOSE}},
+    {319, {"$1 on $t", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {320, {"$1 $t", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {330, {"$1 is logged in as $2", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {338, {"$1 $2 $t", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {369, {"$1 $t", NUMERIC_WHOIS, NUMERIC_VERBOSE}},
+    {378, {"$1 $t", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+    {671, {"$1 $t", NUMERIC_WHOIS, NUMERIC_NORMAL}},
+
+    // list
+    {321, {"Channel Users Topic", NUMERIC_LIST, NUMERIC_VERBOSE}},
+    {322, {"$1 ($2) $t", NUMERIC_LIST, NUMERIC_NORMAL}},
+    {323, {"$t", NUMERIC_LIST, NUMERIC_VERBOSE}},
+
+    // channel
+    {324, {"$1 modes $2 $3", NUMERIC_INFO, NUMERIC_NORMAL}},
+    {329, {"$1 created $2", NUMERIC_INFO, NUMERIC_VERBOSE}},
+    {331, {"$1 has no topic", NUMERIC_TOPIC, NUMERIC_NORMAL}},
+    {332, {"Topic for $1 is: $t", NUMERIC_TOPIC, NUMERIC_ALWAYS}},
+    {333, {"$1 topic set by $2", NUMERIC_TOPIC, NUMERIC_NORMAL}},
+    {341, {"Inviting $1 to $2", NUMERIC_INFO, NUMERIC_NORMAL}},
+
+    // motd
+    {372, {"$t", NUMERIC_MOTD, NUMERIC_ALWAYS}},
+    {375, {"$t", NUMERIC_MOTD, NUMERIC_NORMAL}},
+    {376, {"$t", NUMERIC_MOTD, NUMERIC_VERBOSE}},
+
+    {381, {"$t", NUMERIC_INFO, NUMERIC_NORMAL}},
+    {391, {"$1: $t", NUMERIC_INFO, NUMERIC_NORMAL}},
+
+    // errors that name what they're about
+    {401, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {402, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {403, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {404, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {405, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {406, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {421, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {432, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {433, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {441, {"$1 $2: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {442, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {443, {"$1 $2: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {471, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {473, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {474, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {475, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {477, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+    {482, {"$1: $t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+
+    // sasl
+    {900, {"$t", NUMERIC_INFO, NUMERIC_NORMAL}},
+    {903, {"$t", NUMERIC_INFO, NUMERIC_NORMAL}},
+    {904, {"$t", NUMERIC_ERROR, NUMERIC_ALWAYS}},
+};
+
+struct numeric_table {
+  numeric_format entry[1000];
+};
+
+constexpr numeric_table build_table(void) {
+  numeric_table table{};
+
+  for (int x = 0; x < 1000; ++x) {
+    if ((x >= 400) and (x < 600))
+      table.entry[x] = numeric_format{"$t", NUMERIC_ERROR, NUMERIC_ALWAYS};
+    else
+      table.entry[x] = numeric_format{nullptr, NUMERIC_INFO, NUMERIC_ALWAYS};
+  }
+
+  for (auto const &e : numeric_entries)
+    table.entry[e.numeric] = e.format;
+  return table;
+}
+
+constexpr numeric_table numerics = build_table();
+
+} // namespace
+
+/**
+ * @brief the built-in format for a numeric
+ *
+ * @param numeric 0-999
+ * @return const numeric_format&
+ */
+const numeric_format &numeric_default(int numeric) {
+  return numerics.entry[numeric];
+}
+
+/**
+ * @brief numeric value of a command
+ *
+ * @param cmd
+ * @return int -1 if it isn't a numeric
+ */
+int numeric_value(const std::string &cmd) {
+  if ((cmd.size() != 3) or (!isdigit((unsigned char)cmd[0])) or
+      (!isdigit((unsigned char)cmd[1])) or (!isdigit((unsigned char)cmd[2])))
+    return -1;
+  return (cmd[0] - '0') * 100 + (cmd[1] - '0') * 10 + (cmd[2] - '0');
+}
+
+bool numeric_class_name(const std::string &name, numeric_class &color) {
+  static const struct {
+    const char *name;
+    numeric_class color;
+  } names[] = {
+      {"info", NUMERIC_INFO},   {"error", NUMERIC_ERROR},
+      {"motd", NUMERIC_MOTD},   {"topic", NUMERIC_TOPIC},
+      {"whois", NUMERIC_WHOIS}, {"list", NUMERIC_LIST},
+  };
+
+  for (auto const &n : names) {
+    if (name == n.name) {
+      color = n.color;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief fill in the format template
+ *
+ * parts are [source] [numeric] [our nick] [params...] [trailing]
+ *
+ * @param format
+ * @param parts
+ * @return std::string
+ */
+std::string numeric_expand(const char *format,
+                           const std::vector<std::string> &parts) {
+  std::string output;
+  int size = (int)parts.size();
+  // the last part is the trailing parameter
+  int params_end = size - 1;
+
+  for (const char *f = format; *f != 0; ++f) {
+    if ((*f != '$') or (f[1] == 0)) {
+      output += *f;
+      continue;
+    }
+
+    ++f;
+    if ((*f >= '1') and (*f <= '9')) {
+      int pos = 2 + (*f - '0');
+      if (pos < size)
+        output += parts[pos];
+    } else if (*f == '*') {
+      for (int pos = 3; pos < params_end; ++pos) {
+        if (pos != 3)
+          output += ' ';
+        output += parts[pos];
+      }
+    } else if (*f == 't') {
+      if (size > 3)
+        output += parts[size - 1];
+    } else if (*f == 's') {
+      if ((!parts.empty()) and (!parts[0].empty()))
+        output += (parts[0][0] == ':') ? parts[0].substr(1) : parts[0];
+    } else {
+      output += *f;
+    }
+  }
+  return output;
+}
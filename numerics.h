@@ -0,0 +1,57 @@
+#ifndef NUMERICS_H
+#define NUMERICS_H
+
+#include <string>
+#include <vector>
+
+// color class for a numeric reply
+enum numeric_class : unsigned char {
+  NUMERIC_INFO = 0,
+  NUMERIC_ERROR,
+  NUMERIC_MOTD,
+  NUMERIC_TOPIC,
+  NUMERIC_WHOIS,
+  NUMERIC_LIST,
+};
+
+// verbosity levels, a reply is shown when its level <= numeric_level
+enum numeric_level : unsigned char {
+  NUMERIC_ALWAYS = 0,
+  NUMERIC_NORMAL = 1,
+  NUMERIC_VERBOSE = 2,
+};
+
+/**
+ * @brief How to show a numeric reply
+ *
+ * The format is a template:
+ *   $1 .. $9  parameters (after our nick)
+ *   $*        all of the parameters (without the trailing one)
+ *   $t        trailing parameter
+ *   $s        source (server)
+ *   $$        $
+ *
+ * format nullptr means the reply isn't shown.
+ */
+struct numeric_format {
+  const char *format;
+  numeric_class color;
+  unsigned char level;
+};
+
+/**
+ * @brief numeric_format from the config file
+ */
+struct numeric_override {
+  std::string format;
+  numeric_class color;
+  int level;
+};
+
+const numeric_format &numeric_default(int numeric);
+int numeric_value(const std::string &cmd);
+bool numeric_class_name(const std::string &name, numeric_class &color);
+std::string numeric_expand(const char *format,
+                           const std::vector<std::string> &parts);
+
+#endif
@@ -0,0 +1,88 @@
+#include "paste.h"
+#include "config.h"
+
+paste_buffer paste;
+
+/**
+ * @brief a key came in (any key, including Enter)
+ */
+void paste_buffer::key(void) {
+  auto now = std::chrono::steady_clock::now();
+  auto gap = std::chrono::duration_cast<std::chrono::milliseconds>(
+      now - last_key);
+  if (gap.count() < current_config()->paste_ms)
+    ++fast_keys;
+  else
+    fast_keys = 0;
+  last_key = now;
+}
+
+/**
+ * @brief was the line that Enter just ended pasted?
+ *
+ * Call after key() for the Enter.
+ *
+ * @param door
+ * @param line_size
+ * @return true
+ */
+bool paste_buffer::burst(door::Door &door, size_t line_size) const {
+  if (current_config()->paste_ms == 0)
+    return false;
+  // the first key of a line comes after a pause, the rest (and Enter) don't
+  return (door.haskey()) or (fast_keys >= line_size);
+}
+
+/**
+ * @brief is the key key() just saw part of a paste?
+ *
+ * For keys in the middle of a line:  it came in fast, more keys are waiting
+ * behind it, or pasted lines are still coming in.
+ *
+ * @param door
+ * @return true
+ */
+bool paste_buffer::pasting(door::Door &door) const {
+  if (current_config()->paste_ms == 0)
+    return false;
+  return (pending()) or (door.haskey()) or (fast_keys > 0);
+}
+
+/**
+ * @brief have the keys stopped?
+ *
+ * @return true it's been paste_ms since the last key
+ */
+bool paste_buffer::idle(void) const {
+  auto gap = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - last_key);
+  return gap.count() >= current_config()->paste_ms;
+}
+
+/**
+ * @brief hold a pasted line
+ *
+ * The paste goes to the network and target of its first line.
+ *
+ * @param network
+ * @param line as typed (terminal encoding)
+ */
+void paste_buffer::add(ircClient &network, const std::string &line) {
+  if (lines.empty()) {
+    irc = &network;
+    target = network.talkto();
+  }
+  lines.push_back(line);
+}
+
+/**
+ * @brief the pasted lines, and start over
+ *
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> paste_buffer::take(void) {
+  std::vector<std::string> pasted;
+  pasted.swap(lines);
+  confirm = false;
+  return pasted;
+}
@@ -0,0 +1,50 @@
+#ifndef PASTE_H
+#define PASTE_H
+
+#include "door.h"
+#include "irc.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Paste detection
+ *
+ * A line whose keys (and Enter) all came in faster than paste_ms apart, or
+ * with more keys already waiting behind its Enter, was pasted.  Pasted lines
+ * are held until the keys stop, then sent as one block through the sendq
+ * (see ircClient::send_paste).  More than paste_confirm lines are only sent
+ * after asking.  While a paste is coming in, Tab is just text and hot keys
+ * aren't expanded.  Input thread only.
+ */
+class paste_buffer {
+public:
+  void key(void);
+  bool burst(door::Door &door, size_t line_size) const;
+  bool pasting(door::Door &door) const;
+  bool idle(void) const;
+
+  void add(ircClient &irc, const std::string &line);
+  bool pending(void) const { return !lines.empty(); }
+  size_t size(void) const { return lines.size(); }
+  bool asking(void) const { return confirm; }
+  void ask(void) { confirm = true; }
+
+  ircClient &network(void) const { return *irc; }
+  const std::string &talkto(void) const { return target; }
+  std::vector<std::string> take(void);
+
+private:
+  std::chrono::steady_clock::time_point last_key;
+  size_t fast_keys = 0;
+
+  ircClient *irc = nullptr;
+  std::string target;
+  std::vector<std::string> lines;
+  bool confirm = false;
+};
+
+extern paste_buffer paste;
+
+#endif
@@ -0,0 +1,149 @@
+#include "reactor.h"
+#include "config.h"
+#include "input.h"
+#include "paste.h"
+#include "render.h"
+
+#include <unistd.h>
+
+using namespace std::placeholders;
+
+door_reactor::door_reactor(boost::asio::io_context &io_context,
+                           door::Door &door)
+    : door{door}, context{io_context}, input{io_context}, tick{io_context},
+      paste_timer{io_context} {
+  render_posted = false;
+}
+
+door_reactor::~door_reactor() {
+  for (auto &irc : networks)
+    irc->on_message = nullptr;
+  // don't close stdin, the door still owns it.
+  if (input.is_open())
+    input.release();
+}
+
+/**
+ * @brief Start watching the door input.
+ *
+ * @return true
+ * @return false the door's input can't be used with the io_context
+ */
+bool door_reactor::begin(void) {
+  error_code error;
+  input.assign(STDIN_FILENO, error);
+  if (error)
+    return false;
+
+  for (auto &irc : networks)
+    irc->on_message = std::bind(&door_reactor::on_message, this);
+  wait_input();
+  tick.expires_after(std::chrono::seconds(1));
+  tick.async_wait(std::bind(&door_reactor::on_tick, this, _1));
+  return true;
+}
+
+void door_reactor::wait_input(void) {
+  input.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                   std::bind(&door_reactor::on_input, this, _1));
+}
+
+/**
+ * @brief door input fd is readable.
+ *
+ * Process everything the door has for us, then render anything that
+ * parse_input queued.
+ *
+ * @param error
+ */
+void door_reactor::on_input(error_code error) {
+  if (error)
+    return;
+
+  bool keys = false;
+  while (door.haskey()) {
+    int c = door.sleep_key(1);
+    keys = true;
+    process_key(door, networks.active(), c);
+    if (networks.closed())
+      return;
+    if ((c < -1) or (has_quit))
+      break;
+  }
+  if (!keys) {
+    // readable, but no key:  let the door see the hangup
+    int c = door.sleep_ms_key(1);
+    if (c != -1)
+      process_key(door, networks.active(), c);
+  }
+  if ((paste.pending()) and (!paste.asking()))
+    wait_paste();
+  render();
+  // after a hangup the fd stays readable:  stop watching it, and let the
+  // io_context finish the QUIT and close
+  if (!has_quit)
+    wait_input();
+}
+
+/**
+ * @brief a paste is being held, check on it once the keys could have
+ * stopped
+ */
+void door_reactor::wait_paste(void) {
+  paste_timer.expires_after(
+      std::chrono::milliseconds(current_config()->paste_ms));
+  paste_timer.async_wait(std::bind(&door_reactor::on_paste, this, _1));
+}
+
+void door_reactor::on_paste(error_code error) {
+  if (error)
+    return;
+
+  paste_check(door);
+  if ((paste.pending()) and (!paste.asking()))
+    wait_paste();
+  render();
+}
+
+/**
+ * @brief once a second, let the door check for hangup / out of time.
+ *
+ * @param error
+ */
+void door_reactor::on_tick(error_code error) {
+  if (error)
+    return;
+
+  int c = door.sleep_ms_key(1);
+  if (c != -1) {
+    process_key(door, networks.active(), c);
+    render();
+  }
+  // hung up (or out of time), the QUIT has been sent
+  if ((c < -1) or (has_quit))
+    return;
+
+  tick.expires_after(std::chrono::seconds(1));
+  tick.async_wait(std::bind(&door_reactor::on_tick, this, _1));
+}
+
+/**
+ * @brief ircClient queued a message.
+ *
+ * We're called from inside receive(), so defer the render until it's done.
+ * Several messages in a row only post one render.
+ */
+void door_reactor::on_message(void) {
+  if (render_posted)
+    return;
+  render_posted = true;
+  boost::asio::post(context, [this]() -> void {
+    render_posted = false;
+    render();
+  });
+}
+
+void door_reactor::render(void) {
+  for (auto &irc : networks)
+    render_queue(door, *irc);
+}
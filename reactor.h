@@ -0,0 +1,42 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include "door.h"
+#include "networks.h"
+
+#include <boost/asio.hpp>
+
+/**
+ * @brief Single threaded event loop.
+ *
+ * The door's input fd and the IRC socket share the io_context.  Keys are
+ * handled when the fd is readable, and messages are rendered as soon as any
+ * of the networks queues them.  Everything runs on the thread calling run().
+ */
+class door_reactor {
+  using error_code = boost::system::error_code;
+
+public:
+  door_reactor(boost::asio::io_context &io_context, door::Door &door);
+  ~door_reactor();
+
+  bool begin(void);
+
+private:
+  void wait_input(void);
+  void on_input(error_code error);
+  void on_tick(error_code error);
+  void wait_paste(void);
+  void on_paste(error_code error);
+  void on_message(void);
+  void render(void);
+
+  door::Door &door;
+  boost::asio::io_context &context;
+  boost::asio::posix::stream_descriptor input;
+  boost::asio::steady_timer tick;
+  boost::asio::steady_timer paste_timer;
+  bool render_posted;
+};
+
+#endif
@@ -1,10 +1,17 @@
 #include "render.h"
-
+#include "config.h"
+#include "encoding.h"
+#include "focus.h"
+#include "input.h"
+#include "networks.h"
+#include "numerics.h"
+#include "theme.h"
+#include "trace.h"
+
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
 #include <iomanip>
 
-std::string timestamp_format = "%T";
-
 /**
  * @brief length of the timestamp string.
  *
@@ -12,8 +19,9 @@ std::string timestamp_format = "%T";
 static int stamp_length;
 
 void stamp(std::time_t &stamp, door::Door &door) {
+  config_ptr cfg = current_config();
   std::string output = boost::lexical_cast<std::string>(
-      std::put_time(std::localtime(&stamp), timestamp_format.c_str()));
+      std::put_time(std::localtime(&stamp), cfg->timestamp_format.c_str()));
   if (output.find('A') != std::string::npos)
     door << door::ANSIColor(door::COLOR::YELLOW, door::ATTR::BOLD);
   else
@@ -29,6 +37,9 @@ void word_wrap(int left_side, door::Door &door, std::string text) {
   bool first_line = true;
   door::ANSIColor color = door.previous;
 
+  // one byte per column for CP437, so this has to come first
+  text = to_terminal(text);
+
   /*
     door.log() << "word_wrap " << left_side << " area " << workarea << " ["
                << text << "]" << std::endl;
@@ -63,25 +74,166 @@ void word_wrap(int left_side, door::Door &door, std::string text) {
   }
 }
 
+/**
+ * @brief Is this message for the channel we're talking to?
+ *
+ * Messages from the io thread carry an interned target, so this is a pointer
+ * compare.
+ *
+ * @param msg_stamp
+ * @param target
+ * @param irc
+ * @return true
+ */
+static bool is_talkto(message_stamp &msg_stamp, const std::string &target,
+                      ircClient &irc) {
+  if ((networks.size() > 1) and (&irc != &networks.active()))
+    return false;
+  if (msg_stamp.target != nullptr)
+    return msg_stamp.target == irc.talkto_atom();
+  return target == irc.talkto();
+}
+
+/**
+ * @brief color for a numeric_class
+ */
+static door::ANSIColor numeric_color(numeric_class color) {
+  switch (color) {
+  case NUMERIC_ERROR:
+    return door::ANSIColor{door::COLOR::RED, door::ATTR::BOLD};
+  case NUMERIC_TOPIC:
+    return door::ANSIColor{door::COLOR::GREEN};
+  case NUMERIC_WHOIS:
+    return door::ANSIColor{door::COLOR::GREEN, door::ATTR::BOLD};
+  case NUMERIC_LIST:
+    return door::ANSIColor{door::COLOR::WHITE};
+  case NUMERIC_MOTD:
+  case NUMERIC_INFO:
+  default:
+    return door::ANSIColor{door::COLOR::CYAN};
+  }
+}
+
+/**
+ * @brief Render a numeric reply, using the numeric table.
+ *
+ * The config file can override the built-in formats, and numeric_level
+ * controls how chatty we are.
+ *
+ * @param msg_stamp
+ * @param numeric 0-999
+ * @param irc_msg
+ * @param door
+ */
+static void render_numeric(message_stamp &msg_stamp, int numeric,
+                           std::vector<std::string> &irc_msg,
+                           door::Door &door) {
+  config_ptr cfg = current_config();
+  const numeric_format &def = numeric_default(numeric);
+  const char *format = def.format;
+  numeric_class color = def.color;
+  int level = def.level;
+
+  if (!cfg->numerics.empty()) {
+    auto custom = cfg->numerics.find(numeric);
+    if (custom != cfg->numerics.end()) {
+      format = custom->second.format.c_str();
+      color = custom->second.color;
+      level = custom->second.level;
+    }
+  }
+
+  if ((format == nullptr) or (*format == 0) or (level > cfg->numeric_level))
+    return;
+
+  stamp(msg_stamp.stamp, door);
+  int left = stamp_length + 2;
+  door << numeric_color(color) << "* ";
+  word_wrap(left, door, numeric_expand(format, irc_msg));
+}
+
+/**
+ * @brief a chathistory block
+ *
+ * The whole block goes out together:  one header, the nicks lined up to the
+ * longest in the block (not the channel), and one flush at the end.
+ *
+ * @param block
+ * @param door
+ */
+static void render_history(const history_block &block,
+                           const std::string &channel, door::Door &door) {
+  door::ANSIColor info{door::COLOR::CYAN};
+  door::ANSIColor nick_color{door::COLOR::CYAN, door::ATTR::BOLD};
+  door::ANSIColor text_color{door::COLOR::WHITE};
+
+  size_t width = 0;
+  for (auto const &line : block.lines)
+    width = std::max(width, line.nick.size());
+
+  std::time_t now = time(nullptr);
+  stamp(now, door);
+  door << info << "-- " << channel << " history, " << block.lines.size()
+       << " lines";
+  if (block.skipped)
+    door << " (" << block.skipped << " older not shown)";
+  door << " --" << door::reset << door::nl;
+
+  for (auto const &line : block.lines) {
+    std::time_t when = line.stamp;
+    stamp(when, door);
+    int left = stamp_length + (int)width + 1;
+    door << nick_color << std::string(width - line.nick.size(), ' ');
+    if (line.cmd == CMD_ACTION) {
+      door << "* " << line.nick << " ";
+      left += 2;
+    } else if (line.cmd == CMD_NOTICE) {
+      door << "-" << line.nick << "- ";
+      left += 2;
+    } else {
+      door << line.nick << " ";
+    }
+    door << text_color;
+    word_wrap(left, door, line.text);
+  }
+  door.flush();
+}
+
 void render(message_stamp &msg_stamp, door::Door &door, ircClient &irc) {
-  // std::vector<std::string> irc_msg = *msg;
-  std::vector<std::string> &irc_msg = msg_stamp.buffer;
+  // only the render thread calls us, so reuse the strings
+  static std::vector<std::string> irc_msg;
+  msg_stamp.unpack(irc_msg);
 
   door::ANSIColor info{door::COLOR::CYAN};
-  door::ANSIColor error{door::COLOR::RED, door::ATTR::BOLD};
 
-  if (irc_msg.size() == 1) {
+  if (msg_stamp.cmd == CMD_HISTORY) {
+    history_ptr block = irc.history_pop(irc_msg[0]);
+    if (block)
+      render_history(*block, irc.display_name(block->channel), door);
+    return;
+  }
+
+  // everything else is formatted by the theme
+  theme_values values;
+  values.stamp = msg_stamp.stamp;
+  values.highlight = msg_stamp.highlight;
+  values.align = irc.max_nick_length;
+
+  if (msg_stamp.cmd == CMD_SYSTEM) {
     // system message
-    stamp(msg_stamp.stamp, door);
-    door << info << "(" << irc_msg[0] << ")" << door::reset << door::nl;
+    std::string net;
+    if (!irc.network.empty())
+      net = irc.network + ": ";
+    values.fields[FIELD_NET] = &net;
+    values.fields[FIELD_TEXT] = &irc_msg[0];
+    theme.run(THEME_SYSTEM, values, door);
     return;
   }
 
-  door::ANSIColor nick_color{door::COLOR::CYAN, door::ATTR::BOLD};
-  door::ANSIColor channel_color{door::COLOR::WHITE, door::COLOR::BLUE};
-  door::ANSIColor active_channel_color =
-      door::ANSIColor{door::COLOR::YELLOW, door::COLOR::BLUE, door::ATTR::BOLD};
-  door::ANSIColor text_color{door::COLOR::WHITE};
+  if (msg_stamp.highlight) {
+    // someone said our nick (or a highlight word)
+    door << (char)7;
+  }
 
   std::string &source = irc_msg[0];
   std::string &cmd = irc_msg[1];
@@ -91,183 +243,88 @@ void render(message_stamp &msg_stamp, door::Door &door, ircClient &irc) {
   std::string msg;
   if (irc_msg.size() > 3)
     msg = irc_msg[irc_msg.size() - 1];
+  std::string nick;
+  std::string channel;
 
-  if (source == "ERROR") {
-    std::string tmp = cmd;
-    /*
-    if (tmp[0] == ':')
-      tmp.erase(0, 1);
-      */
-    stamp(msg_stamp.stamp, door);
-    door << error << "* ERROR: " << tmp << door::reset << door::nl;
-  }
+  values.fields[FIELD_TARGET] = &target;
+  values.fields[FIELD_NICK] = &nick;
+  values.fields[FIELD_CHAN] = &channel;
+  values.fields[FIELD_TEXT] = &msg;
 
-  if (cmd == "332") {
-    // joined channel with topic
-    std::string output = "Topic for " + irc_msg[3] + " is: " + msg;
-    stamp(msg_stamp.stamp, door);
-    int left = stamp_length;
-    door << info;
-    word_wrap(left, door, output);
-    // << output << door::reset << door::nl;
+  if (source == "ERROR") {
+    values.fields[FIELD_TEXT] = &cmd;
+    theme.run(THEME_ERROR, values, door);
   }
 
   if (cmd == "366") {
     // end of names, output and clear
     std::string channel = irc_msg[3]; // split_limit(irc_msg[3], 2)[0];
 
-    irc.channels_lock.lock();
+    snapshot_ptr snapshot = irc.channels_snapshot();
     stamp(msg_stamp.stamp, door);
-    int count = irc.channels[channel].size();
+    auto ch = snapshot->channels.find(channel);
+    int count = 0;
+    if (ch != snapshot->channels.end())
+      count = ch->second->size();
 
     if (count > 10) {
       door << info << "* " << count << " users on " << channel;
     } else {
       door << info << "* users on " << channel << " : ";
-      for (auto name : irc.channels[channel]) {
-        door << name << " ";
+      if (count > 0) {
+        for (auto const &name : *ch->second) {
+          door << name << " ";
+        }
       }
     }
-    irc.channels_lock.unlock();
     door << door::reset << door::nl;
     // names.clear();
   }
 
-  if (cmd == "372") {
-    // MOTD
-    // std::string temp = irc_msg[3];
-    // temp.erase(0, 1);
-    stamp(msg_stamp.stamp, door);
-    door << info << "* " << msg << door::reset << door::nl;
-  }
-
-  // 400 and 500 are errors?  should show those.
-  if ((cmd[0] == '4') or (cmd[0] == '5')) {
-    // std::string tmp = irc_msg[3];
-    // if (tmp[0] == ':')
-    //  tmp.erase(0, 1);
-    stamp(msg_stamp.stamp, door);
-    door << error << "* " << msg << door::reset << door::nl;
+  if (msg_stamp.cmd == CMD_OTHER) {
+    // 366 is above, it needs the channel snapshot.
+    int numeric = numeric_value(cmd);
+    if ((numeric != -1) and (numeric != 366))
+      render_numeric(msg_stamp, numeric, irc_msg, door);
   }
 
-  if (cmd == "NOTICE") {
+  if (msg_stamp.cmd == CMD_NOTICE) {
     // NOTICE doesn't display the target (nick or channel)
-    std::string tmp = irc_msg[3];
-    // tmp.erase(0, 1);
-    stamp(msg_stamp.stamp, door);
-    int left = stamp_length;
-    std::string nick = parse_nick(irc_msg[0]);
-    door << nick_color << nick << " NOTICE ";
-    left += nick.size() + 8;
-    word_wrap(left, door, tmp);
-    // << tmp << door::reset << door::nl;
+    nick = parse_nick(source);
+    theme.run(THEME_NOTICE, values, door);
   }
 
-  if (cmd == "ACTION") {
-    // if (irc_msg[2][0] == '#') {
-    if (target[0] == '#') {
-      stamp(msg_stamp.stamp, door);
-      int left = stamp_length;
-      if (target == irc.talkto())
-        door << active_channel_color;
-      else
-        door << channel_color;
-      door << target << "/" << nick_color;
-      left += target.size() + 1;
-
-      std::string nick = parse_nick(source);
-      left += nick.size();
-      int len = irc.max_nick_length - nick.size();
-      if (len > 0) {
-        door << std::string(len, ' ');
-        left += len;
-      }
-      left += 3;
-      door << "* " << nick << " ";
-      word_wrap(left, door, msg); // irc_msg[3]);
-      // << irc_msg[3] << door::reset << door::nl;
-      /*
-      door << "* " << irc_msg[2] << "/" << parse_nick(irc_msg[0]) << " "
-           << irc_msg[3] << door::nl;
-           */
-    } else {
-      stamp(msg_stamp.stamp, door);
-      int left = stamp_length;
-      std::string nick = parse_nick(source);
-      door << nick_color << "* " << nick << " ";
-      left += 3 + nick.size();
-      word_wrap(left, door, msg); // irc_msg[3]);
-      // << irc_msg[3] << door::reset << door::nl;
-
-      // door << "* " << parse_nick(irc_msg[0]) << " " << irc_msg[3] <<
-      // door::nl;
+  if ((msg_stamp.cmd == CMD_ACTION) or (msg_stamp.cmd == CMD_PRIVMSG)) {
+    bool action = (msg_stamp.cmd == CMD_ACTION);
+    nick = parse_nick(source);
+    std::string me;
+    if (action) {
+      me = "* " + nick;
+      values.fields[FIELD_ACTION] = &me;
     }
-  }
 
-  if (cmd == "TOPIC") {
-    std::string tmp = irc_msg[3];
-    tmp.erase(0, 1);
-    stamp(msg_stamp.stamp, door);
-    int left = stamp_length;
-    door << info;
-    std::string text =
-        parse_nick(irc_msg[0]) + " set topic of " + irc_msg[2] + " to " + tmp;
-    word_wrap(left, door, text);
-    // door << info << parse_nick(irc_msg[0]) << " set topic of " << irc_msg[2]
-    //     << " to " << tmp << door::reset << door::nl;
-  }
-
-  if (cmd == "PRIVMSG") {
     if (target[0] == '#') {
-      // std::string tmp = irc_msg[3];
-      // tmp.erase(0, 1);
-
-      stamp(msg_stamp.stamp, door);
-      int left = stamp_length;
-
-      if (target == irc.talkto())
-        door << active_channel_color;
-      else
-        door << channel_color;
-      door << target << "/" << nick_color;
-      left += target.size() + 1;
-      std::string nick = parse_nick(source);
-      left += nick.size();
-      int len = irc.max_nick_length + 2 - nick.size();
-      if (len > 0) {
-        door << std::string(len, ' ');
-        left += len;
-      }
-      door << nick << " " << text_color;
-      left++;
-      word_wrap(left, door, msg); // tmp);
-      // << tmp << door::reset << door::nl;
-      /*
-      door << channel_color << irc_msg[2] << "/" << nick_color
-           << parse_nick(irc_msg[0]) << door::reset << " " << tmp << door::nl;
-      */
+      channel = irc.display_name(target);
+      values.talkto = is_talkto(msg_stamp, target, irc);
+      theme.run(action ? THEME_CHANNEL_ACTION : THEME_CHANNEL_MESSAGE, values,
+                door);
     } else {
-      // std::string tmp = irc_msg[3];
-      // tmp.erase(0, 1);
-      stamp(msg_stamp.stamp, door);
-      int left = stamp_length;
-      std::string nick = parse_nick(irc_msg[0]);
-      door << nick_color << nick << door::reset << " ";
-      left += nick.size() + 1;
-      word_wrap(left, door, msg);
-      // << tmp << door::nl;
+      theme.run(action ? THEME_PRIVATE_ACTION : THEME_PRIVATE_MESSAGE, values,
+                door);
     }
   }
 
-  if (cmd == "NICK") {
-    // std::string tmp = irc_msg[2];
-    // tmp.erase(0, 1);
-    stamp(msg_stamp.stamp, door);
-    door << info << "* " << parse_nick(irc_msg[0]) << " is now known as "
-         << target << door::reset << door::nl;
+  if (msg_stamp.cmd == CMD_TOPIC) {
+    nick = parse_nick(source);
+    theme.run(THEME_TOPIC, values, door);
+  }
+
+  if (msg_stamp.cmd == CMD_NICK) {
+    nick = parse_nick(source);
+    theme.run(THEME_NICK, values, door);
   }
 
-  if (cmd == "MODE") {
+  if (msg_stamp.cmd == CMD_MODE) {
     // [:ChanServ!services@services.red-green.com] [MODE] [#chat] [+o Apollo]
     // ChanServ gives channel operator status to bugz
 
@@ -275,9 +332,11 @@ void render(message_stamp &msg_stamp, door::Door &door, ircClient &irc) {
     // source sets target mode [whatever]
     // If not a channel: source sets target mode [whatever]
 
-    std::string target = irc_msg[2];
-    std::string nick = parse_nick(irc_msg[0]);
+    nick = parse_nick(source);
     std::string modes = irc_msg[3];
+    if (irc_msg.size() > 4)
+      modes += " " + irc_msg[4];
+    values.fields[FIELD_MODES] = &modes;
 
     if (target[0] == '#') {
       // pay attention to channel modes.  Forget user modes for now.
@@ -321,11 +380,7 @@ void render(message_stamp &msg_stamp, door::Door &door, ircClient &irc) {
       // [#bugz] [+i] []
 
       // modes on a user in the channel
-      stamp(msg_stamp.stamp, door);
-      door << info << "* " << nick << " sets MODE " << modes;
-      if (irc_msg.size() > 4)
-        door << " " << irc_msg[4];
-      door << " on " << target << door::reset << door::nl;
+      theme.run(THEME_MODE, values, door);
 
       /*
       if (mode == "+o") {
@@ -356,3 +411,63 @@ void render(message_stamp &msg_stamp, door::Door &door, ircClient &irc) {
     }
   }
 }
+
+/**
+ * @brief Render all of the queued messages.
+ *
+ * The input line is cleared before the first message, and restored after the
+ * last one.
+ *
+ * @param door
+ * @param irc
+ * @return true messages were rendered
+ */
+bool render_queue(door::Door &door, ircClient &irc) {
+  // stage times of what we rendered, when tracing
+  static std::vector<trace_times> rendered;
+  message_ptr msg;
+  bool input_cleared = false;
+  int unread = focus.unread();
+
+  // we switched to a channel focused mode was holding
+  if (focus.waiting(irc)) {
+    input_cleared = true;
+    clear_input(door);
+    focus.show(door, irc);
+  }
+
+  if (irc.channels_updated)
+    while ((msg = irc.message_pop())) {
+      if (focus.hold(msg, irc))
+        continue;
+
+      if (!input_cleared) {
+        input_cleared = true;
+        clear_input(door);
+      }
+
+      render(*msg, door, irc);
+      if (tracer.enabled())
+        rendered.push_back(msg->trace);
+    }
+
+  if (input_cleared)
+    restore_input(door);
+
+  // held messages don't clear the input line, but they change its count
+  if (focus.unread() != unread)
+    unread_changed(door);
+
+  if (!rendered.empty()) {
+    // it's on the screen once the door has sent it
+    door.flush();
+    tracer.shown(rendered);
+  }
+
+  if (irc.list_ready.exchange(false)) {
+    channel_pager.begin(irc.list_results());
+    channel_pager.page(door);
+    input_cleared = true;
+  }
+  return input_cleared;
+}
@@ -6,9 +6,9 @@
 #include <string>
 #include <vector>
 
-extern std::string timestamp_format;
-
 void render(message_stamp &irc_msg, door::Door &door, ircClient &irc);
 void stamp(std::time_t &stamp, door::Door &door);
+void word_wrap(int left_side, door::Door &door, std::string text);
+bool render_queue(door::Door &door, ircClient &irc);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "clock.h"
+#include "config.h"
+#include "irc.h"
+#include "transport.h"
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * irc-sim:  runs the protocol engine against a scripted server, over the
+ * memory transport, on a frozen irc_clock.
+ *
+ * Registers, then 5 hours of channel traffic with the lag meter PINGing
+ * every minute (the server answers), then the server stops answering and
+ * the watchdog has to drop the link.  Hours of protocol time take well under
+ * a second, and the run is the same every time.
+ *
+ * Exits non-zero on the first check that fails (ctest runs it).
+ */
+
+static int failed = 0;
+
+static void check(bool ok, const std::string &what) {
+  if (!ok) {
+    std::cerr << "FAIL: " << what << std::endl;
+    ++failed;
+  }
+}
+
+int main(void) {
+  using namespace std::chrono_literals;
+  const std::time_t start = 1700000000;
+  const int hours = 5;
+
+  publish_config(std::make_shared<door_config>());
+  irc_clock::simulate(start);
+
+  boost::asio::io_context io_context;
+  ircClient irc(io_context);
+  irc.nick = "bugz";
+  irc.autojoin = "#test";
+  irc.lag_check(60, 3);
+  irc.on_closed = []() {};
+
+  memory_transport *server = new memory_transport(io_context);
+  std::vector<std::string> sent;
+  int pings = 0;
+  bool answer = true;
+
+  server->on_line = [&](const std::string &line) {
+    sent.push_back(line);
+    if ((answer) and (line.compare(0, 5, "PING ") == 0)) {
+      ++pings;
+      server->send(":irc.test PONG irc.test " + line.substr(5));
+    }
+  };
+  irc.use_transport(std::unique_ptr<irc_transport>(server));
+
+  irc.begin();
+  run_for(io_context, 1ms);
+
+  bool nick = false;
+  for (auto const &line : sent) {
+    if (line == "NICK bugz")
+      nick = true;
+  }
+  check(nick, "registration sends NICK");
+
+  server->send(":irc.test 001 bugz :Welcome");
+  server->send(":irc.test 376 bugz :End of MOTD");
+  run_for(io_context, 1ms);
+  check(irc.registered, "registered after 376");
+
+  int lines = 0;
+  for (int second = 0; second < hours * 3600; ++second) {
+    if (second % 10 == 0)
+      server->send(":nick!user@host PRIVMSG #test :line " +
+                   std::to_string(second));
+    run_for(io_context, 1s);
+    while (irc.message_pop())
+      ++lines;
+  }
+
+  check(irc_clock::wall() - start >= hours * 3600, "clock advanced");
+  check(lines >= hours * 360, "channel lines received");
+  // one PING a minute
+  check((pings >= hours * 60 - 1) and (pings <= hours * 60 + 1),
+        "lag PINGs: " + std::to_string(pings));
+  check(!irc.shutdown, "link still up while the server answers");
+
+  // the server goes quiet:  3 missed PINGs, and it's dead
+  answer = false;
+  for (int second = 0; (second < 400) and (!irc.shutdown); ++second)
+    run_for(io_context, 1s);
+  check(irc.shutdown, "dead link detected");
+
+  if (failed == 0)
+    std::cout << "irc-sim: ok (" << hours << " hours, " << lines
+              << " lines, " << pings << " pings)" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,497 @@
+#include "theme.h"
+#include "config.h"
+#include "encoding.h"
+#include "render.h" // word_wrap
+
+#include "yaml-cpp/yaml.h"
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+render_theme theme;
+
+namespace {
+
+enum theme_op : uint8_t {
+  OP_END = 0,    // reset, newline
+  OP_LITERAL,    // index (2 bytes)
+  OP_COLOR,      // slot
+  OP_COLOR_IF,   // condition, slot when true, slot when false
+  OP_FIELD,      // field, align, from max_nick_length, width
+  OP_WRAP,       // same as OP_FIELD, word wrapped (always last)
+};
+
+enum theme_condition : uint8_t {
+  IF_TALKTO = 0,
+  IF_HIGHLIGHT,
+};
+
+const char *event_names[THEME_EVENTS] = {
+    "channel_message", "private_message", "channel_action",
+    "private_action",  "notice",          "topic",
+    "nick",            "mode",            "system",
+    "error",
+};
+
+const char *field_names[THEME_FIELDS] = {
+    "time", "net", "chan", "target", "nick", "action", "modes", "text",
+};
+
+// the built-in theme (what render() always looked like)
+const char *default_formats[THEME_EVENTS] = {
+    "{@time}{time} {@chan}{chan}/{@nick}{nick:>align+2} {@text}{text}",
+    "{@time}{time} {@nick}{nick}{@reset} {@text}{text}",
+    "{@time}{time} {@chan}{chan}/{@nick}{action:>align+2} {@text}{text}",
+    "{@time}{time} {@nick}{action} {@text}{text}",
+    "{@time}{time} {@nick}{nick} NOTICE {@text}{text}",
+    "{@time}{time} {@info}{nick} set topic of {target} to {text}",
+    "{@time}{time} {@info}* {nick} is now known as {target}",
+    "{@time}{time} {@info}* {nick} sets MODE {modes} on {target}",
+    "{@time}{time} {@info}({net}{text})",
+    "{@time}{time} {@error}* ERROR: {text}",
+};
+
+const std::pair<const char *, const char *> default_colors[] = {
+    {"time", "brown"},
+    {"info", "cyan"},
+    {"nick", "bold cyan"},
+    {"channel", "white on blue"},
+    {"talkto", "bold yellow on blue"},
+    {"text", "white"},
+    {"highlight", "bold yellow"},
+    {"error", "bold red"},
+};
+
+bool color_name(const std::string &name, door::COLOR &color) {
+  static const std::pair<const char *, door::COLOR> names[] = {
+      {"black", door::COLOR::BLACK},     {"red", door::COLOR::RED},
+      {"green", door::COLOR::GREEN},     {"brown", door::COLOR::BROWN},
+      {"yellow", door::COLOR::YELLOW},   {"blue", door::COLOR::BLUE},
+      {"magenta", door::COLOR::MAGENTA}, {"cyan", door::COLOR::CYAN},
+      {"white", door::COLOR::WHITE},
+  };
+  for (auto const &n : names) {
+    if (name == n.first) {
+      color = n.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief "bold yellow on blue" to an ANSIColor
+ *
+ * @param spec [bold|blink|reverse] [color] [on color]
+ * @param color
+ * @return false spec isn't a color
+ */
+bool parse_color(const std::string &spec, door::ANSIColor &color) {
+  std::istringstream words(spec);
+  std::string word;
+  bool has_fg = false, has_bg = false, has_attr = false;
+  door::COLOR fg = door::COLOR::WHITE, bg = door::COLOR::BLACK;
+  door::ATTR attr = door::ATTR::RESET;
+
+  while (words >> word) {
+    if (word == "on") {
+      if ((!(words >> word)) or (!color_name(word, bg)) or (has_bg))
+        return false;
+      has_bg = true;
+    } else if ((word == "bold") or (word == "blink") or (word == "reverse")) {
+      if (has_attr)
+        return false; // just one
+      has_attr = true;
+      attr = (word == "bold")    ? door::ATTR::BOLD
+             : (word == "blink") ? door::ATTR::BLINK
+                                 : door::ATTR::INVERSE;
+    } else if ((!has_fg) and (color_name(word, fg))) {
+      has_fg = true;
+    } else
+      return false;
+  }
+
+  if ((!has_fg) and (!has_attr))
+    return false;
+  if (!has_fg)
+    color = door::ANSIColor(attr);
+  else if (has_bg)
+    color = has_attr ? door::ANSIColor(fg, bg, attr) : door::ANSIColor(fg, bg);
+  else
+    color = has_attr ? door::ANSIColor(fg, attr) : door::ANSIColor(fg);
+  return true;
+}
+
+/**
+ * @brief columns the text takes up on the terminal
+ *
+ * @param bytes already in the terminal's encoding
+ */
+int text_width(const std::string &bytes) {
+  if (door_encoding == ENCODING_CP437)
+    return (int)bytes.size();
+  int width = 0;
+  for (unsigned char c : bytes) {
+    if ((c & 0xc0) != 0x80)
+      ++width;
+  }
+  return width;
+}
+
+/**
+ * @brief the {time} text
+ *
+ * Lines mostly come in with the same stamp, so the last one is kept.
+ */
+const std::string &time_text(std::time_t stamp) {
+  static std::time_t last_stamp = -1;
+  static std::string last_format;
+  static std::string text;
+
+  config_ptr cfg = current_config();
+  if ((stamp != last_stamp) or (cfg->timestamp_format != last_format)) {
+    last_stamp = stamp;
+    last_format = cfg->timestamp_format;
+    text = boost::lexical_cast<std::string>(
+        std::put_time(std::localtime(&stamp), last_format.c_str()));
+  }
+  return text;
+}
+
+const std::string empty;
+
+} // namespace
+
+/**
+ * @brief the slot for a {@spec}, adding it when it's new
+ *
+ * @param spec a color name (from colors:) or a color spec
+ * @param problem set when it's neither
+ * @return int slot, -1 on error
+ */
+int render_theme::color_slot(const std::string &spec, std::string &problem) {
+  for (size_t x = 0; x < color_names.size(); ++x) {
+    if (color_names[x] == spec)
+      return (int)x;
+  }
+
+  door::ANSIColor color;
+  if ((color_names.size() >= 255) or (!parse_color(spec, color))) {
+    problem = "{@" + spec + "} isn't a color";
+    return -1;
+  }
+  color_names.push_back(spec);
+  colors.push_back(color);
+  escapes.push_back(color.output());
+  return (int)color_names.size() - 1;
+}
+
+/**
+ * @brief compile a format
+ *
+ * @param format
+ * @param output the bytecode
+ * @param problem why it didn't compile
+ * @return true
+ */
+bool render_theme::compile(const std::string &format,
+                           std::vector<uint8_t> &output,
+                           std::string &problem) {
+  std::vector<uint8_t> program;
+  std::string text;
+  size_t last_field = std::string::npos; // where the last OP_FIELD starts
+
+  auto flush_text = [&]() -> bool {
+    if (text.empty())
+      return true;
+    if (literals.size() >= 0xffff) {
+      problem = "too much text";
+      return false;
+    }
+    std::string bytes = to_terminal(text);
+    literals.push_back(literal{bytes, text_width(bytes)});
+    program.push_back(OP_LITERAL);
+    program.push_back((uint8_t)((literals.size() - 1) & 0xff));
+    program.push_back((uint8_t)((literals.size() - 1) >> 8));
+    text.clear();
+    last_field = std::string::npos;
+    return true;
+  };
+
+  for (size_t pos = 0; pos < format.size(); ++pos) {
+    char c = format[pos];
+    if (((c == '{') or (c == '}')) and (pos + 1 < format.size()) and
+        (format[pos + 1] == c)) {
+      text += c;
+      ++pos;
+      continue;
+    }
+    if (c == '}') {
+      problem = "} without {";
+      return false;
+    }
+    if (c != '{') {
+      text += c;
+      continue;
+    }
+
+    size_t close = format.find('}', pos);
+    if (close == std::string::npos) {
+      problem = "{ without }";
+      return false;
+    }
+    std::string item = format.substr(pos + 1, close - pos - 1);
+    pos = close;
+    if (!flush_text())
+      return false;
+
+    if ((!item.empty()) and (item[0] == '@')) {
+      std::string name = item.substr(1);
+      if ((name == "chan") or (name == "text")) {
+        bool chan = (name == "chan");
+        int yes = color_slot(chan ? "talkto" : "highlight", problem);
+        int no = color_slot(chan ? "channel" : "text", problem);
+        program.push_back(OP_COLOR_IF);
+        program.push_back(chan ? IF_TALKTO : IF_HIGHLIGHT);
+        program.push_back((uint8_t)yes);
+        program.push_back((uint8_t)no);
+      } else {
+        int slot = color_slot(name, problem);
+        if (slot < 0)
+          return false;
+        program.push_back(OP_COLOR);
+        program.push_back((uint8_t)slot);
+      }
+      last_field = std::string::npos;
+      continue;
+    }
+
+    // {field} or {field:>width}
+    std::string name = item.substr(0, item.find(':'));
+    int field = -1;
+    for (int x = 0; x < THEME_FIELDS; ++x) {
+      if (name == field_names[x])
+        field = x;
+    }
+    if (field == -1) {
+      problem = "{" + name + "} isn't a field";
+      return false;
+    }
+
+    uint8_t align = 0, from_align = 0;
+    int width = 0;
+    if (name.size() < item.size()) {
+      std::string spec = item.substr(name.size() + 1);
+      if ((spec.empty()) or ((spec[0] != '<') and (spec[0] != '>'))) {
+        problem = "{" + item + "} needs :<width or :>width";
+        return false;
+      }
+      align = spec[0];
+      spec.erase(0, 1);
+      if (spec.compare(0, 5, "align") == 0) {
+        from_align = 1;
+        spec.erase(0, 5);
+        if ((!spec.empty()) and (spec[0] == '+'))
+          spec.erase(0, 1);
+      }
+      char *end;
+      width = spec.empty() ? 0 : (int)strtol(spec.c_str(), &end, 10);
+      if (((!spec.empty()) and (*end != 0)) or (width < -100) or
+          (width > 100)) {
+        problem = "{" + item + "} width isn't a number (-100 to 100)";
+        return false;
+      }
+    }
+
+    last_field = program.size();
+    program.push_back(OP_FIELD);
+    program.push_back((uint8_t)field);
+    program.push_back(align);
+    program.push_back(from_align);
+    program.push_back((uint8_t)(int8_t)width);
+  }
+
+  if (!flush_text())
+    return false;
+  if (last_field != std::string::npos)
+    program[last_field] = OP_WRAP;
+  else
+    program.push_back(OP_END);
+  output.swap(program);
+  return true;
+}
+
+/**
+ * @brief load a theme file, over the built-in theme
+ *
+ * @param filename empty is just the built-in theme
+ * @param problems what's wrong with the file (those parts use the built-in
+ * theme)
+ * @return true the file loaded (or there wasn't one)
+ */
+bool render_theme::load(const std::string &filename,
+                        std::vector<std::string> &problems) {
+  std::string problem;
+  bool loaded = true;
+  literals.clear();
+  color_names.clear();
+  colors.clear();
+  escapes.clear();
+
+  color_names.push_back("reset");
+  colors.push_back(door::reset);
+  escapes.push_back(door::reset.output());
+
+  YAML::Node file;
+  if (!filename.empty()) {
+    try {
+      file = YAML::LoadFile(filename);
+    } catch (YAML::Exception &e) {
+      problems.push_back(filename + ": " + e.what());
+      loaded = false;
+    }
+  }
+
+  // colors first, the formats use them
+  for (auto const &def : default_colors) {
+    std::string spec = def.second;
+    try {
+      if ((file["colors"]) and (file["colors"][def.first]))
+        spec = file["colors"][def.first].as<std::string>();
+    } catch (YAML::Exception &e) {
+      problems.push_back(std::string("colors: ") + def.first + ": " +
+                         e.what());
+    }
+    door::ANSIColor color;
+    if (!parse_color(spec, color)) {
+      problems.push_back(std::string("colors: ") + def.first + ": " + spec +
+                         " isn't a color");
+      parse_color(def.second, color);
+    }
+    color_names.push_back(def.first);
+    colors.push_back(color);
+    escapes.push_back(color.output());
+  }
+
+  for (int x = 0; x < THEME_EVENTS; ++x) {
+    std::string format = default_formats[x];
+    try {
+      if ((file["formats"]) and (file["formats"][event_names[x]]))
+        format = file["formats"][event_names[x]].as<std::string>();
+    } catch (YAML::Exception &e) {
+      problems.push_back(std::string("formats: ") + event_names[x] + ": " +
+                         e.what());
+    }
+    if (compile(format, code[x], problem))
+      continue;
+    problems.push_back(std::string("formats: ") + event_names[x] + ": " +
+                       problem);
+    compile(default_formats[x], code[x], problem);
+  }
+  return loaded;
+}
+
+void render_theme::color(door::Door &door, uint8_t slot) const {
+  door << escapes[slot];
+  // word_wrap picks the color back up from previous
+  door.previous = colors[slot];
+}
+
+/**
+ * @brief render one message
+ *
+ * @param event
+ * @param values
+ * @param door
+ */
+void render_theme::run(theme_event event, const theme_values &values,
+                       door::Door &door) const {
+  static const std::string spaces(128, ' ');
+  if (code[event].empty())
+    return; // not loaded
+  const uint8_t *pc = code[event].data();
+  int column = 0;
+
+  for (;;) {
+    switch (*pc++) {
+    case OP_END:
+      door << door::reset << door::nl;
+      return;
+
+    case OP_LITERAL: {
+      const literal &lit = literals[pc[0] | (pc[1] << 8)];
+      pc += 2;
+      door << lit.bytes;
+      column += lit.width;
+      break;
+    }
+
+    case OP_COLOR:
+      color(door, *pc++);
+      break;
+
+    case OP_COLOR_IF: {
+      bool on = (pc[0] == IF_TALKTO) ? values.talkto : values.highlight;
+      color(door, on ? pc[1] : pc[2]);
+      pc += 3;
+      break;
+    }
+
+    case OP_FIELD:
+    case OP_WRAP: {
+      bool wrap = (pc[-1] == OP_WRAP);
+      uint8_t field = pc[0];
+      uint8_t align = pc[1];
+      int width = (int8_t)pc[3] + (pc[2] ? values.align : 0);
+      pc += 4;
+
+      const std::string *text = (field == FIELD_TIME)
+                                    ? &time_text(values.stamp)
+                                    : values.fields[field];
+      if (text == nullptr)
+        text = &empty;
+      if (wrap) {
+        // word_wrap() transcodes the text itself
+        if (align == '>') {
+          int pad = std::min(width - text_width(to_terminal(*text)),
+                             (int)spaces.size());
+          if (pad > 0) {
+            door.write(spaces.data(), pad);
+            column += pad;
+          }
+        }
+        word_wrap(column, door, *text);
+        return;
+      }
+
+      // nicks and channels can be UTF-8 too
+      std::string transcoded;
+      if (door_encoding == ENCODING_CP437) {
+        transcoded = to_terminal(*text);
+        text = &transcoded;
+      }
+      int shown = text_width(*text);
+      int pad = std::min(width - shown, (int)spaces.size());
+
+      if ((align == '>') and (pad > 0)) {
+        door.write(spaces.data(), pad);
+        column += pad;
+      }
+      door << *text;
+      column += shown;
+      if ((align == '<') and (pad > 0)) {
+        door.write(spaces.data(), pad);
+        column += pad;
+      }
+      break;
+    }
+
+    default:
+      // can't happen, compile() only makes the ones above
+      door << door::reset << door::nl;
+      return;
+    }
+  }
+}
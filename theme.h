@@ -0,0 +1,104 @@
+#ifndef THEME_H
+#define THEME_H
+
+#include "door.h"
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// what's being rendered
+enum theme_event : unsigned char {
+  THEME_CHANNEL_MESSAGE = 0,
+  THEME_PRIVATE_MESSAGE,
+  THEME_CHANNEL_ACTION,
+  THEME_PRIVATE_ACTION,
+  THEME_NOTICE,
+  THEME_TOPIC,
+  THEME_NICK,
+  THEME_MODE,
+  THEME_SYSTEM,
+  THEME_ERROR,
+  THEME_EVENTS
+};
+
+// the {fields} a format can use ({time} comes from the stamp)
+enum theme_field : unsigned char {
+  FIELD_TIME = 0,
+  FIELD_NET,
+  FIELD_CHAN,
+  FIELD_TARGET,
+  FIELD_NICK,
+  FIELD_ACTION,
+  FIELD_MODES,
+  FIELD_TEXT,
+  THEME_FIELDS
+};
+
+/**
+ * @brief One message's values, for render_theme::run
+ *
+ * fields[] point at strings the caller owns (nullptr is empty).
+ */
+struct theme_values {
+  std::time_t stamp = 0;
+  const std::string *fields[THEME_FIELDS] = {};
+  // is it for the talkto channel?  ({@chan})
+  bool talkto = false;
+  // highlighted?  ({@text})
+  bool highlight = false;
+  // width for :>align (max_nick_length)
+  int align = 0;
+};
+
+/**
+ * @brief Render formats, compiled
+ *
+ * A theme file (YAML) has colors and formats:
+ *
+ *   colors:
+ *     nick: bold cyan
+ *     talkto: bold yellow on blue
+ *   formats:
+ *     private_message: "{@time}{time} {@nick}<{nick}> {@text}{text}"
+ *
+ * {field} or {field:>width} / {field:<width}, where width is a number or
+ * align (the longest nick) +/- a number.  {@name} switches to a color from
+ * colors (or a color spec, "bold red on black").  {@chan} is talkto when
+ * it's for the channel we're talking to, {@text} is highlight when it's
+ * highlighted.  {{ and }} are { and }.  A field at the very end of the
+ * format is word wrapped.
+ *
+ * Anything missing from the file uses the built-in theme.  Formats are
+ * compiled to bytecode, with the color escapes and the terminal encoding
+ * of the literal text done once, so run() only copies bytes and fields.
+ * Load at startup, run() is for the render thread.
+ */
+class render_theme {
+public:
+  bool load(const std::string &filename, std::vector<std::string> &problems);
+  void run(theme_event event, const theme_values &values,
+           door::Door &door) const;
+
+private:
+  struct literal {
+    std::string bytes;
+    int width;
+  };
+
+  bool compile(const std::string &format, std::vector<uint8_t> &code,
+               std::string &problem);
+  int color_slot(const std::string &spec, std::string &problem);
+  void color(door::Door &door, uint8_t slot) const;
+
+  std::vector<literal> literals;
+  std::vector<std::string> color_names;
+  std::vector<door::ANSIColor> colors;
+  std::vector<std::string> escapes;
+  std::vector<uint8_t> code[THEME_EVENTS];
+};
+
+extern render_theme theme;
+
+#endif
@@ -0,0 +1,150 @@
+#include "trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <sys/stat.h>
+
+message_tracer tracer;
+
+const int message_tracer::buckets[BUCKETS - 1] = {10,    100,    1000,
+                                                  10000, 100000, 1000000};
+
+int64_t trace_now(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+message_tracer::message_tracer() {
+  sample_every = 0;
+  traced = 0;
+  for (auto &stage : histogram)
+    for (auto &count : stage)
+      count = 0;
+}
+
+/**
+ * @brief the name of the time that ends at stage (TRACE_READ is the total)
+ */
+const char *message_tracer::stage_name(int stage) {
+  static const char *names[TRACE_STAGES] = {"total", "parse", "queue lock",
+                                            "queue wait", "render"};
+  return names[stage];
+}
+
+/**
+ * @brief turn tracing on (startup)
+ *
+ * save() writes directory/node<node>.json, so nodes don't collide.
+ *
+ * @param sample export one in sample messages, 0 is off
+ * @param directory
+ * @param node
+ */
+void message_tracer::enable(int sample, const std::string &directory,
+                            int node) {
+  file = directory + "/node" + std::to_string(node) + ".json";
+  if (sample > 0)
+    mkdir(directory.c_str(), 0755);
+  sample_every = sample;
+}
+
+/**
+ * @brief render flushed a batch (render thread)
+ *
+ * @param batch the rendered messages' times, cleared
+ */
+void message_tracer::shown(std::vector<trace_times> &batch) {
+  int64_t now = trace_now();
+  for (auto &times : batch) {
+    times.at[TRACE_SHOWN] = now;
+    finish(times);
+  }
+  batch.clear();
+}
+
+static void count(std::atomic<unsigned> *histogram, int64_t us) {
+  int x = 0;
+  while ((x < message_tracer::BUCKETS - 1) and
+         (us >= message_tracer::buckets[x]))
+    ++x;
+  ++histogram[x];
+}
+
+void message_tracer::finish(const trace_times &times) {
+  for (int stage = TRACE_PARSED; stage < TRACE_STAGES; ++stage) {
+    if ((times.at[stage - 1] != 0) and (times.at[stage] != 0))
+      count(histogram[stage], times.at[stage] - times.at[stage - 1]);
+  }
+  // system messages don't come from a read
+  if (times.at[TRACE_READ] == 0)
+    return;
+  count(histogram[TRACE_READ], times.at[TRACE_SHOWN] - times.at[TRACE_READ]);
+
+  if (++traced % sample_every != 0)
+    return;
+  lock.lock();
+  samples.push_back(times);
+  if (samples.size() > MAX_SAMPLES)
+    samples.pop_front();
+  lock.unlock();
+}
+
+/**
+ * @brief write the samples as Chrome trace-event JSON
+ *
+ * Each message is a flow of complete ("X") events:  parse and queue lock
+ * on the irc thread, queue wait, then render on the render thread.
+ *
+ * @param error why it didn't save
+ * @return true
+ */
+bool message_tracer::save(std::string &error) {
+  lock.lock();
+  std::vector<trace_times> copy(samples.begin(), samples.end());
+  lock.unlock();
+
+  std::ofstream out(file, std::ofstream::out | std::ofstream::trunc);
+  if (!out) {
+    error = "Unable to write " + file;
+    return false;
+  }
+
+  static const int thread_of[TRACE_STAGES] = {0, 1, 1, 2, 3};
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+      << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+         "\"args\":{\"name\":\"irc\"}},\n"
+      << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+         "\"args\":{\"name\":\"queue\"}},\n"
+      << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,"
+         "\"args\":{\"name\":\"render\"}}";
+
+  for (size_t x = 0; x < copy.size(); ++x) {
+    const trace_times &times = copy[x];
+    for (int stage = TRACE_PARSED; stage < TRACE_STAGES; ++stage) {
+      if ((times.at[stage - 1] == 0) or (times.at[stage] == 0))
+        continue;
+      out << ",\n{\"name\":\"" << stage_name(stage)
+          << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread_of[stage]
+          << ",\"ts\":" << times.at[stage - 1]
+          << ",\"dur\":" << times.at[stage] - times.at[stage - 1]
+          << ",\"args\":{\"message\":" << x << "}}";
+    }
+  }
+  out << "\n]}\n";
+  out.close();
+  if (!out) {
+    error = "Unable to write " + file;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief at exit, save what was sampled
+ */
+void message_tracer::end_session(void) {
+  std::string error;
+  if ((enabled()) and (traced >= (unsigned)sample_every))
+    save(error);
+}
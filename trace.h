@@ -0,0 +1,77 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <boost/signals2/mutex.hpp>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// where a message is on its way from the ircd to the screen
+enum trace_stage : unsigned char {
+  TRACE_READ = 0, // read_until() has the line
+  TRACE_PARSED,   // receive() is done with it
+  TRACE_QUEUED,   // message_append() has queued it (lock held)
+  TRACE_POPPED,   // message_pop() gave it to render
+  TRACE_SHOWN,    // rendered, and the door flushed
+  TRACE_STAGES
+};
+
+/**
+ * @brief steady clock microseconds for each stage (0 wasn't recorded)
+ */
+struct trace_times {
+  int64_t at[TRACE_STAGES];
+};
+
+int64_t trace_now(void);
+
+/**
+ * @brief Per message latency tracing
+ *
+ * Off unless trace_sample is set.  Every traced message adds its stage
+ * times to the histograms, and one in sample_every (that came from the
+ * ircd) is kept to export as Chrome trace-event JSON (chrome://tracing,
+ * Perfetto).  Safe from any thread.
+ */
+class message_tracer {
+public:
+  static const int BUCKETS = 7;
+  // histogram[x][b] counts stage x times under buckets[b] us (the last
+  // bucket is everything over), x is the stage it ended at, and
+  // TRACE_READ is the whole trip (read to shown)
+  static const int buckets[BUCKETS - 1];
+  std::atomic<unsigned> histogram[TRACE_STAGES][BUCKETS];
+  static const char *stage_name(int stage);
+
+  message_tracer();
+
+  void enable(int sample, const std::string &directory, int node);
+  bool enabled(void) const { return sample_every != 0; }
+  void mark(trace_times &times, trace_stage stage) {
+    if (sample_every != 0)
+      times.at[stage] = trace_now();
+  }
+  void shown(std::vector<trace_times> &batch);
+
+  bool save(std::string &error);
+  const std::string &filename(void) const { return file; }
+  void end_session(void);
+
+private:
+  void finish(const trace_times &times);
+
+  // keep at most this many samples (the oldest go)
+  static const size_t MAX_SAMPLES = 20000;
+
+  std::atomic<int> sample_every;
+  std::atomic<unsigned> traced;
+  std::string file;
+  boost::signals2::mutex lock;
+  std::deque<trace_times> samples;
+};
+
+extern message_tracer tracer;
+
+#endif
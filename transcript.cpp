@@ -0,0 +1,535 @@
+#include "transcript.h"
+#include "complete.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+transcript_writer transcripts;
+
+/**
+ * @brief transcript file name (without .log / .idx) for a channel
+ *
+ * Case folded, anything odd becomes '_' (so #bugz is _bugz).
+ *
+ * @param channel
+ * @return std::string
+ */
+std::string transcript_name(const std::string &channel) {
+  std::string name = irc_fold(channel);
+  for (auto &c : name) {
+    if ((!isalnum((unsigned char)c)) and (c != '-'))
+      c = '_';
+  }
+  return name;
+}
+
+/**
+ * @brief the transcript directory for this user
+ *
+ * Creates the directories if needed.
+ *
+ * @param directory
+ * @param handle
+ * @return std::string
+ */
+std::string transcript_directory(const std::string &directory,
+                                 const std::string &handle) {
+  mkdir(directory.c_str(), 0755);
+  std::string name = handle;
+  for (auto &c : name) {
+    if (!isalnum((unsigned char)c))
+      c = '_';
+  }
+  std::string path = directory + "/" + name;
+  mkdir(path.c_str(), 0755);
+  return path;
+}
+
+/**
+ * @brief words for the bloom filter / search
+ *
+ * Lower case, split on anything that isn't a letter or digit (UTF-8 bytes
+ * count as letters).  Single characters are skipped.
+ *
+ * @param text
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> transcript_words(const std::string &text) {
+  std::vector<std::string> words;
+  std::string word;
+
+  for (char c : text) {
+    unsigned char uc = (unsigned char)c;
+    if ((isalnum(uc)) or (uc >= 0x80)) {
+      word += (char)tolower(uc);
+    } else {
+      if (word.size() > 1)
+        words.push_back(word);
+      word.clear();
+    }
+  }
+  if (word.size() > 1)
+    words.push_back(word);
+  return words;
+}
+
+static uint64_t word_hash(const std::string &word) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : word) {
+    hash ^= (uint8_t)c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// double hashing:  probe x is h1 + x * h2
+void bloom_add(uint64_t *bloom, const std::string &word) {
+  uint64_t hash = word_hash(word);
+  uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+  for (uint32_t x = 0; x < BLOOM_HASHES; ++x) {
+    uint32_t bit = (h1 + x * h2) % BLOOM_BITS;
+    bloom[bit / 64] |= (1ull << (bit % 64));
+  }
+}
+
+bool bloom_has(const uint64_t *bloom, const std::string &word) {
+  uint64_t hash = word_hash(word);
+  uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+  for (uint32_t x = 0; x < BLOOM_HASHES; ++x) {
+    uint32_t bit = (h1 + x * h2) % BLOOM_BITS;
+    if ((bloom[bit / 64] & (1ull << (bit % 64))) == 0)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief write all of it (retrying short writes)
+ *
+ * @return false the write failed, some of it may have landed
+ */
+static bool write_all(int fd, const void *buffer, size_t size) {
+  const char *data = (const char *)buffer;
+  while (size > 0) {
+    ssize_t wrote = write(fd, data, size);
+    if (wrote < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += wrote;
+    size -= wrote;
+  }
+  return true;
+}
+
+transcript_writer::~transcript_writer() { end(); }
+
+void transcript_writer::begin(const std::string &directory) {
+  if ((directory.empty()) or (running))
+    return;
+  this->directory = directory;
+  running = true;
+  writer = std::thread(&transcript_writer::run, this);
+}
+
+/**
+ * @brief write what's queued, and stop the writer thread
+ */
+void transcript_writer::end(void) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!running)
+      return;
+    running = false;
+  }
+  wake.notify_one();
+  writer.join();
+}
+
+/**
+ * @brief queue a line (any thread)
+ */
+void transcript_writer::append(const std::string &channel, int cmd,
+                               const std::string &nick,
+                               const std::string &text, std::time_t stamp) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!running)
+    return;
+  pending.push_back(line{channel, cmd, nick, text, stamp});
+  if (pending.size() >= BLOCK_RECORDS)
+    wake.notify_one();
+}
+
+void transcript_writer::run(void) {
+  std::unique_lock<std::mutex> guard(lock);
+  std::vector<line> batch;
+
+  while (running) {
+    wake.wait_for(guard, std::chrono::seconds(1), [this]() -> bool {
+      return (!running) or (pending.size() >= BLOCK_RECORDS);
+    });
+    batch.swap(pending);
+    guard.unlock();
+    if (!batch.empty())
+      write_lines(batch);
+    batch.clear();
+    guard.lock();
+  }
+
+  batch.swap(pending);
+  guard.unlock();
+  write_lines(batch);
+  close_all();
+}
+
+/**
+ * @brief open (or create) a channel's files
+ *
+ * A partial record (or index entry) at the end is from a crash (or a failed
+ * write), and is dropped.  Records after the last index entry are the block
+ * in progress, so its bloom filter is rebuilt.
+ *
+ * @param channel
+ * @return channel_file&
+ */
+transcript_writer::channel_file &
+transcript_writer::open(const std::string &channel) {
+  std::string name = transcript_name(channel);
+  auto pos = files.find(name);
+  if (pos != files.end())
+    return pos->second;
+
+  channel_file &f = files[name];
+  std::string filename = directory + "/" + name;
+  f.fd =
+      ::open((filename + ".log").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  f.index_fd =
+      ::open((filename + ".idx").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if ((f.fd == -1) or (f.index_fd == -1)) {
+    close_file(f);
+    return f;
+  }
+
+  struct stat st;
+  fstat(f.fd, &st);
+  f.records = st.st_size / sizeof(transcript_record);
+  if ((st.st_size % sizeof(transcript_record)) and
+      (ftruncate(f.fd, f.records * sizeof(transcript_record)) == -1)) {
+    close_file(f);
+    return f;
+  }
+
+  fstat(f.index_fd, &st);
+  off_t entries = st.st_size / sizeof(transcript_index);
+  if ((st.st_size % sizeof(transcript_index)) and
+      (ftruncate(f.index_fd, entries * sizeof(transcript_index)) == -1)) {
+    close_file(f);
+    return f;
+  }
+
+  uint32_t start = 0;
+  if (entries > 0) {
+    transcript_index last;
+    if (pread(f.index_fd, &last, sizeof(last),
+              (entries - 1) * sizeof(transcript_index)) == sizeof(last))
+      start = last.record + last.count;
+  }
+
+  f.block = transcript_index{};
+  f.block.record = start;
+  for (uint32_t r = start; r < f.records; ++r) {
+    transcript_record record;
+    if (pread(f.fd, &record, sizeof(record), r * sizeof(record)) !=
+        sizeof(record))
+      break;
+    if (f.block.count == 0)
+      f.block.stamp = record.stamp;
+    ++f.block.count;
+    for (auto const &word : transcript_words(
+             std::string(record.text, record.text_length)))
+      bloom_add(f.block.bloom, word);
+  }
+  return f;
+}
+
+/**
+ * @brief write a batch (writer thread)
+ *
+ * One write() per channel, unless a block fills up:  then the records so far
+ * are written, followed by the block's index entry, and both are synced.
+ *
+ * If a write fails the channel's files are closed, and the rest of its lines
+ * in the batch are dropped.  The next batch reopens them, so the record count
+ * and block in progress come from what actually landed on disk.  An index
+ * entry is only written once its block's records are.
+ *
+ * @param lines
+ */
+void transcript_writer::write_lines(std::vector<line> &lines) {
+  std::map<channel_file *, std::string> buffers;
+  // records in the buffer are counted once they're written
+  auto flush = [this](channel_file &f, std::string &buffer) -> bool {
+    bool ok = write_all(f.fd, buffer.data(), buffer.size());
+    if (ok)
+      f.records += buffer.size() / sizeof(transcript_record);
+    else
+      close_file(f);
+    buffer.clear();
+    return ok;
+  };
+
+  for (auto const &l : lines) {
+    channel_file &f = open(l.channel);
+    if ((f.fd == -1) or (f.index_fd == -1))
+      continue;
+
+    std::string &buffer = buffers[&f];
+    std::vector<std::string> words = transcript_words(l.text);
+    size_t pos = 0;
+    bool first = true;
+
+    do {
+      transcript_record record;
+      memset(&record, 0, sizeof(record));
+      record.stamp = l.stamp;
+      record.cmd = (uint8_t)l.cmd;
+      record.flags = first ? 0 : RECORD_CONTINUED;
+      record.nick_length =
+          (uint8_t)std::min(l.nick.size(), sizeof(record.nick));
+      memcpy(record.nick, l.nick.data(), record.nick_length);
+
+      size_t length = std::min(l.text.size() - pos, sizeof(record.text));
+      // don't split a UTF-8 sequence
+      while ((length > 1) and (pos + length < l.text.size()) and
+             (((unsigned char)l.text[pos + length] & 0xc0) == 0x80))
+        --length;
+      record.text_length = (uint8_t)length;
+      memcpy(record.text, l.text.data() + pos, length);
+      pos += length;
+
+      if (f.block.count == 0) {
+        f.block.stamp = record.stamp;
+        f.block.record = f.records + buffer.size() / sizeof(record);
+      }
+      if ((first) or (f.block.count == 0)) {
+        // the whole message's words go in each block it touches
+        for (auto const &word : words)
+          bloom_add(f.block.bloom, word);
+      }
+      first = false;
+
+      buffer.append((const char *)&record, sizeof(record));
+      ++f.block.count;
+
+      if (f.block.count == BLOCK_RECORDS) {
+        // checkpoint
+        if (!flush(f, buffer))
+          break;
+        if (!write_all(f.index_fd, &f.block, sizeof(f.block))) {
+          close_file(f);
+          break;
+        }
+        fdatasync(f.fd);
+        fdatasync(f.index_fd);
+        f.block = transcript_index{};
+      }
+    } while (pos < l.text.size());
+  }
+
+  for (auto &b : buffers) {
+    if ((b.first->fd != -1) and (!b.second.empty()))
+      flush(*b.first, b.second);
+  }
+
+  // closed (or never opened):  try again next batch
+  for (auto pos = files.begin(); pos != files.end();) {
+    if (pos->second.fd == -1)
+      pos = files.erase(pos);
+    else
+      ++pos;
+  }
+}
+
+void transcript_writer::close_file(channel_file &f) {
+  if (f.fd != -1)
+    close(f.fd);
+  if (f.index_fd != -1)
+    close(f.index_fd);
+  f.fd = f.index_fd = -1;
+}
+
+void transcript_writer::close_all(void) {
+  for (auto &f : files)
+    close_file(f.second);
+  files.clear();
+}
+
+transcript_reader::~transcript_reader() {
+  if (data != nullptr)
+    munmap((void *)data, data_bytes);
+  if (index != nullptr)
+    munmap((void *)index, index_bytes);
+}
+
+static const void *map_file(const std::string &filename, size_t record_size,
+                            size_t &bytes) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    return nullptr;
+
+  struct stat st;
+  fstat(fd, &st);
+  bytes = (st.st_size / record_size) * record_size;
+  void *map = nullptr;
+  if (bytes > 0) {
+    map = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+      map = nullptr;
+  }
+  close(fd);
+  return map;
+}
+
+/**
+ * @brief map a channel transcript
+ *
+ * @param directory
+ * @param channel
+ * @return true there's something to read
+ */
+bool transcript_reader::open(const std::string &directory,
+                             const std::string &channel) {
+  std::string filename = directory + "/" + transcript_name(channel);
+
+  data = (const transcript_record *)map_file(
+      filename + ".log", sizeof(transcript_record), data_bytes);
+  if (data == nullptr)
+    return false;
+  records = data_bytes / sizeof(transcript_record);
+
+  index = (const transcript_index *)map_file(
+      filename + ".idx", sizeof(transcript_index), index_bytes);
+  blocks = (index == nullptr) ? 0 : index_bytes / sizeof(transcript_index);
+  // an index entry can be ahead of the records we mapped
+  while ((blocks > 0) and
+         (index[blocks - 1].record + index[blocks - 1].count > records))
+    --blocks;
+  return true;
+}
+
+/**
+ * @brief first record at or after since
+ *
+ * Binary search of the index, then a scan of (at most) one block and the
+ * records after the last index entry.
+ *
+ * @param since
+ * @return size_t size() if there's nothing
+ */
+size_t transcript_reader::find_time(std::time_t since) const {
+  size_t pos = 0;
+
+  if (blocks > 0) {
+    const transcript_index *found = std::upper_bound(
+        index, index + blocks, (int64_t)since,
+        [](int64_t stamp, const transcript_index &entry) -> bool {
+          return stamp < entry.stamp;
+        });
+    if (found != index)
+      pos = (found - 1)->record;
+  }
+
+  while ((pos < records) and (data[pos].stamp < since))
+    ++pos;
+  return pos;
+}
+
+/**
+ * @brief the message starting at pos (with the continued records)
+ */
+std::string transcript_reader::text(size_t pos) const {
+  std::string result(data[pos].text, data[pos].text_length);
+  for (++pos; (pos < records) and (data[pos].flags & RECORD_CONTINUED); ++pos)
+    result.append(data[pos].text, data[pos].text_length);
+  return result;
+}
+
+/**
+ * @brief check the messages in records [start, end), newest first
+ *
+ * @return true found has max_results
+ */
+bool transcript_reader::block_match(size_t start, size_t end,
+                                    const std::vector<std::string> &words,
+                                    std::vector<size_t> &found,
+                                    size_t max_results) const {
+  for (size_t pos = end; pos > start;) {
+    --pos;
+    if (data[pos].flags & RECORD_CONTINUED)
+      continue;
+
+    // whole words, the same as the bloom filter
+    std::vector<std::string> message = transcript_words(text(pos));
+    bool match = true;
+    for (auto const &word : words) {
+      if (std::find(message.begin(), message.end(), word) == message.end()) {
+        match = false;
+        break;
+      }
+    }
+    if (match) {
+      found.push_back(pos);
+      if (found.size() >= max_results)
+        return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief messages with all of the words
+ *
+ * Blocks whose bloom filter doesn't have every word are skipped without
+ * looking at them.
+ *
+ * @param words
+ * @param max_results the newest max_results matches are returned
+ * @return std::vector<size_t> record positions, oldest first
+ */
+std::vector<size_t> transcript_reader::search(const std::string &words,
+                                              size_t max_results) const {
+  std::vector<size_t> found;
+  std::vector<std::string> search_words = transcript_words(words);
+  if ((search_words.empty()) or (max_results == 0))
+    return found;
+  found.reserve(max_results);
+
+  // the block in progress isn't in the index
+  size_t indexed =
+      (blocks > 0) ? index[blocks - 1].record + index[blocks - 1].count : 0;
+  bool full = block_match(indexed, records, search_words, found, max_results);
+
+  for (size_t b = blocks; (b > 0) and (!full);) {
+    --b;
+    bool candidate = true;
+    for (auto const &word : search_words) {
+      if (!bloom_has(index[b].bloom, word)) {
+        candidate = false;
+        break;
+      }
+    }
+    if (candidate)
+      full = block_match(index[b].record, index[b].record + index[b].count,
+                         search_words, found, max_results);
+  }
+
+  std::reverse(found.begin(), found.end());
+  return found;
+}
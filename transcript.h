@@ -0,0 +1,146 @@
+#ifndef TRANSCRIPT_H
+#define TRANSCRIPT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief One transcript record (fixed width)
+ *
+ * Text that doesn't fit continues in the next record(s), which have
+ * RECORD_CONTINUED set.
+ */
+struct transcript_record {
+  int64_t stamp;
+  uint8_t cmd; // message_cmd
+  uint8_t flags;
+  uint8_t nick_length;
+  uint8_t text_length;
+  char nick[32];
+  char text[212];
+};
+
+static_assert(sizeof(transcript_record) == 256, "transcript_record size");
+
+enum : uint8_t { RECORD_CONTINUED = 1 };
+
+const uint32_t BLOCK_RECORDS = 64;
+
+/**
+ * @brief Bloom filter bits per block
+ *
+ * A block holds a few hundred distinct words.  At about 10 bits a word (and
+ * BLOOM_HASHES probes) the false positive rate stays around 1%.
+ */
+const uint32_t BLOOM_BITS = 4096;
+const uint32_t BLOOM_HASHES = 6;
+
+/**
+ * @brief Sparse index entry, one per block of BLOCK_RECORDS records
+ *
+ * The bloom filter has the words in the block, so /search only looks at the
+ * blocks that can match.
+ */
+struct transcript_index {
+  int64_t stamp; // first record in the block
+  uint32_t record;
+  uint32_t count;
+  uint64_t bloom[BLOOM_BITS / 64];
+};
+
+static_assert(sizeof(transcript_index) == 528, "transcript_index size");
+
+/**
+ * @brief Appends channel transcripts, from its own thread.
+ *
+ * append() just queues the line.  The writer thread batches the queue into
+ * one write per channel.  Each full block adds an index entry, and is a
+ * checkpoint (fdatasync).  Files are:  directory/channel.log and .idx
+ */
+class transcript_writer {
+public:
+  ~transcript_writer();
+
+  void begin(const std::string &directory);
+  void end(void);
+  void append(const std::string &channel, int cmd, const std::string &nick,
+              const std::string &text, std::time_t stamp);
+  const std::string &path(void) const { return directory; }
+
+private:
+  struct line {
+    std::string channel;
+    int cmd;
+    std::string nick;
+    std::string text;
+    std::time_t stamp;
+  };
+
+  struct channel_file {
+    int fd = -1;
+    int index_fd = -1;
+    uint32_t records = 0; // on disk
+    transcript_index block{};
+  };
+
+  void run(void);
+  void write_lines(std::vector<line> &lines);
+  channel_file &open(const std::string &channel);
+  void close_file(channel_file &f);
+  void close_all(void);
+
+  std::string directory;
+  std::thread writer;
+  std::mutex lock;
+  std::condition_variable wake;
+  std::vector<line> pending;
+  bool running = false;
+  std::map<std::string, channel_file> files;
+};
+
+/**
+ * @brief Read only (mmap) view of a channel transcript.
+ */
+class transcript_reader {
+public:
+  ~transcript_reader();
+
+  bool open(const std::string &directory, const std::string &channel);
+
+  size_t size(void) const { return records; }
+  const transcript_record &operator[](size_t pos) const { return data[pos]; }
+
+  size_t find_time(std::time_t since) const;
+  std::vector<size_t> search(const std::string &words,
+                             size_t max_results) const;
+  std::string text(size_t pos) const;
+
+private:
+  bool block_match(size_t start, size_t end,
+                   const std::vector<std::string> &words,
+                   std::vector<size_t> &found, size_t max_results) const;
+
+  const transcript_record *data = nullptr;
+  size_t records = 0;
+  size_t data_bytes = 0;
+  const transcript_index *index = nullptr;
+  size_t blocks = 0;
+  size_t index_bytes = 0;
+};
+
+std::string transcript_name(const std::string &channel);
+std::string transcript_directory(const std::string &directory,
+                                 const std::string &handle);
+void bloom_add(uint64_t *bloom, const std::string &word);
+bool bloom_has(const uint64_t *bloom, const std::string &word);
+std::vector<std::string> transcript_words(const std::string &text);
+
+extern transcript_writer transcripts;
+
+#endif
@@ -0,0 +1,276 @@
+#include "transport.h"
+
+#include <sstream>
+
+using error_code = boost::system::error_code;
+using boost::asio::ip::tcp;
+
+namespace {
+
+template <class Endpoint> std::string endpoint_text(const Endpoint &endpoint) {
+  std::ostringstream text;
+  text << endpoint;
+  return text.str();
+}
+
+/**
+ * @brief TLS over TCP
+ */
+class tls_transport : public irc_transport {
+public:
+  tls_transport(boost::asio::io_context &io_context,
+                const std::string &hostname, const std::string &port)
+      : resolver{io_context}, ssl_context{boost::asio::ssl::context::tls},
+        socket{io_context, ssl_context}, hostname{hostname}, port{port} {}
+
+  void connect(connect_handler done) override {
+    resolver.async_resolve(
+        hostname, port,
+        [this, done](error_code error, tcp::resolver::results_type results) {
+          if (error) {
+            done(error, "Unable to resolve (DNS Issue?)");
+            return;
+          }
+          boost::asio::async_connect(
+              socket.next_layer(), results,
+              [this, done](error_code error, const tcp::endpoint &endpoint) {
+                if (error) {
+                  done(error, "Unable to connect");
+                  return;
+                }
+                std::string where = endpoint_text(endpoint);
+                socket.async_handshake(
+                    boost::asio::ssl::stream_base::client,
+                    [done, where](error_code error) {
+                      done(error, error ? "Handshake Failure" : where);
+                    });
+              });
+        });
+  }
+
+  void read_line(boost::asio::streambuf &buffer, read_handler done) override {
+    boost::asio::async_read_until(socket, buffer, '\n', done);
+  }
+
+  void write(const std::string &data, error_code &error) override {
+    boost::asio::write(socket, boost::asio::buffer(data), error);
+  }
+
+  void shutdown(shutdown_handler done) override {
+    socket.async_shutdown(done);
+  }
+
+  void close(void) override {
+    error_code ignore;
+    socket.lowest_layer().close(ignore);
+  }
+
+private:
+  // initialization order matters for socket, ssl_context!
+  tcp::resolver resolver;
+  boost::asio::ssl::context ssl_context;
+  boost::asio::ssl::stream<tcp::socket> socket;
+  std::string hostname;
+  std::string port;
+};
+
+/**
+ * @brief Plain TCP, or a Unix domain socket
+ *
+ * The two only differ in how they connect.
+ */
+template <class Socket> class socket_transport : public irc_transport {
+public:
+  socket_transport(boost::asio::io_context &io_context)
+      : socket{io_context}, context(io_context) {}
+
+  void read_line(boost::asio::streambuf &buffer, read_handler done) override {
+    boost::asio::async_read_until(socket, buffer, '\n', done);
+  }
+
+  void write(const std::string &data, error_code &error) override {
+    boost::asio::write(socket, boost::asio::buffer(data), error);
+  }
+
+  // nothing to say goodbye with, just close
+  void shutdown(shutdown_handler done) override {
+    close();
+    boost::asio::post(context, [done]() { done(error_code()); });
+  }
+
+  void close(void) override {
+    error_code ignore;
+    socket.shutdown(Socket::shutdown_both, ignore);
+    socket.close(ignore);
+  }
+
+protected:
+  Socket socket;
+  boost::asio::io_context &context;
+};
+
+class tcp_transport : public socket_transport<tcp::socket> {
+public:
+  tcp_transport(boost::asio::io_context &io_context,
+                const std::string &hostname, const std::string &port)
+      : socket_transport{io_context}, resolver{io_context}, hostname{hostname},
+        port{port} {}
+
+  void connect(connect_handler done) override {
+    resolver.async_resolve(
+        hostname, port,
+        [this, done](error_code error, tcp::resolver::results_type results) {
+          if (error) {
+            done(error, "Unable to resolve (DNS Issue?)");
+            return;
+          }
+          boost::asio::async_connect(
+              socket, results,
+              [done](error_code error, const tcp::endpoint &endpoint) {
+                done(error,
+                     error ? "Unable to connect" : endpoint_text(endpoint));
+              });
+        });
+  }
+
+private:
+  tcp::resolver resolver;
+  std::string hostname;
+  std::string port;
+};
+
+typedef boost::asio::local::stream_protocol::socket unix_socket;
+
+class unix_transport : public socket_transport<unix_socket> {
+public:
+  unix_transport(boost::asio::io_context &io_context, const std::string &path)
+      : socket_transport{io_context}, path{path} {}
+
+  void connect(connect_handler done) override {
+    std::string where = path;
+    socket.async_connect(
+        boost::asio::local::stream_protocol::endpoint(path),
+        [done, where](error_code error) {
+          done(error, error ? "Unable to connect" : where);
+        });
+  }
+
+private:
+  std::string path;
+};
+
+} // namespace
+
+memory_transport::memory_transport(boost::asio::io_context &io_context)
+    : context(io_context) {}
+
+void memory_transport::connect(connect_handler done) {
+  boost::asio::post(context, [done]() { done(error_code(), "memory"); });
+}
+
+/**
+ * @brief give the client a line
+ *
+ * @param line without the CR LF
+ */
+void memory_transport::send(const std::string &line) {
+  inbound += line + "\r\n";
+  deliver();
+}
+
+void memory_transport::hangup(void) {
+  closed = true;
+  deliver();
+}
+
+void memory_transport::read_line(boost::asio::streambuf &buffer,
+                                 read_handler done) {
+  reader = &buffer;
+  waiting = done;
+  deliver();
+}
+
+/**
+ * @brief complete the waiting read, if there's a line (or EOF) for it
+ */
+void memory_transport::deliver(void) {
+  if (!waiting)
+    return;
+
+  size_t eol = inbound.find('\n');
+  if ((eol == std::string::npos) and (!closed))
+    return;
+
+  read_handler done;
+  done.swap(waiting);
+  if (eol == std::string::npos) {
+    boost::asio::post(context, [done]() {
+      done(boost::asio::error::eof, 0);
+    });
+    return;
+  }
+
+  size_t bytes = eol + 1;
+  std::ostream(reader).write(inbound.data(), bytes);
+  inbound.erase(0, bytes);
+  boost::asio::post(context, [done, bytes]() { done(error_code(), bytes); });
+}
+
+void memory_transport::write(const std::string &data, error_code &error) {
+  if (closed) {
+    error = boost::asio::error::broken_pipe;
+    return;
+  }
+  error = error_code();
+
+  outbound += data;
+  size_t eol;
+  while ((eol = outbound.find('\n')) != std::string::npos) {
+    std::string line = outbound.substr(0, eol);
+    outbound.erase(0, eol + 1);
+    if ((!line.empty()) and (line[line.size() - 1] == '\r'))
+      line.erase(line.size() - 1);
+    if (on_line)
+      on_line(line);
+  }
+}
+
+void memory_transport::shutdown(shutdown_handler done) {
+  closed = true;
+  deliver();
+  boost::asio::post(context, [done]() { done(error_code()); });
+}
+
+void memory_transport::close(void) {
+  closed = true;
+  deliver();
+}
+
+bool valid_transport(const std::string &kind) {
+  return (kind == "tls") or (kind == "tcp") or (kind == "unix");
+}
+
+/**
+ * @brief the transport for a transport config setting
+ *
+ * memory isn't one of them, simulations hand their memory_transport to
+ * ircClient::use_transport.
+ *
+ * @param io_context
+ * @param kind tls, tcp or unix
+ * @param hostname (path for unix)
+ * @param port
+ * @return std::unique_ptr<irc_transport>
+ */
+std::unique_ptr<irc_transport>
+make_transport(boost::asio::io_context &io_context, const std::string &kind,
+               const std::string &hostname, const std::string &port) {
+  if (kind == "tcp")
+    return std::unique_ptr<irc_transport>(
+        new tcp_transport(io_context, hostname, port));
+  if (kind == "unix")
+    return std::unique_ptr<irc_transport>(
+        new unix_transport(io_context, hostname));
+  return std::unique_ptr<irc_transport>(
+      new tls_transport(io_context, hostname, port));
+}
@@ -0,0 +1,81 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ * @brief How ircClient reaches the server
+ *
+ * The protocol engine only connects, reads lines, writes and shuts down,
+ * so it runs the same over any of these:
+ *
+ * tls     TLS over TCP (the default)
+ * tcp     plain TCP, for an ircd or bouncer on localhost
+ * unix    a Unix domain socket, hostname is the path
+ * memory  an in-process pipe, the other end is driven by code (simulations)
+ */
+class irc_transport {
+public:
+  using error_code = boost::system::error_code;
+  // on error, step says what failed ("Unable to connect"), otherwise it's
+  // where we're connected
+  typedef std::function<void(error_code error, const std::string &step)>
+      connect_handler;
+  typedef std::function<void(error_code error, std::size_t bytes)>
+      read_handler;
+  typedef std::function<void(error_code error)> shutdown_handler;
+
+  virtual ~irc_transport() {}
+
+  virtual void connect(connect_handler done) = 0;
+  // bytes is the line, up to and including the \n
+  virtual void read_line(boost::asio::streambuf &buffer,
+                         read_handler done) = 0;
+  virtual void write(const std::string &data, error_code &error) = 0;
+  virtual void shutdown(shutdown_handler done) = 0;
+  // right now, no goodbyes (dead link)
+  virtual void close(void) = 0;
+};
+
+/**
+ * @brief The in-process transport
+ *
+ * Lines the client writes go to on_line (on the writer's thread), send()
+ * gives the client a line.  hangup() is the server closing.  send() and
+ * hangup() are for the io_context thread.
+ */
+class memory_transport : public irc_transport {
+public:
+  memory_transport(boost::asio::io_context &io_context);
+
+  std::function<void(const std::string &line)> on_line;
+  void send(const std::string &line);
+  void hangup(void);
+
+  void connect(connect_handler done) override;
+  void read_line(boost::asio::streambuf &buffer, read_handler done) override;
+  void write(const std::string &data, error_code &error) override;
+  void shutdown(shutdown_handler done) override;
+  void close(void) override;
+
+private:
+  void deliver(void);
+
+  boost::asio::io_context &context;
+  std::string inbound;
+  std::string outbound;
+  boost::asio::streambuf *reader = nullptr;
+  read_handler waiting;
+  bool closed = false;
+};
+
+bool valid_transport(const std::string &kind);
+std::unique_ptr<irc_transport>
+make_transport(boost::asio::io_context &io_context, const std::string &kind,
+               const std::string &hostname, const std::string &port);
+
+#endif